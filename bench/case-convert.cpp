@@ -0,0 +1,233 @@
+/*
+ * case-convert.cpp - upper/lower throughput on synthetic corpora
+ * Part of QCO MoreUtils - Advanced System Development More Utilities
+ *
+ * Copyright 2025 AnmiTaliDev
+ * Licensed under the Apache License, Version 2.0
+ *
+ * Built and run by case-convert.sh. Generates pure ASCII, mixed UTF-8,
+ * short line, long line and CRLF corpora and converts each in every mode
+ * four ways: in process through CaseEngine's own conversion step, once
+ * with the scalar ASCII loop and once with the SIMD kernels, and through
+ * the built upper/lower programs, once with the file as an argument (the
+ * mmap path) and once through a pipe (the read(2) path). Prints MB/s and
+ * cycles per byte for each; cycles are TSC ticks where there is a TSC.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "../src/common/case_engine.h"
+
+struct Result {
+    double mbs;
+    double cpb;     // cycles per byte, 0 when unknown
+};
+
+static unsigned long long ticks() {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Best of five runs of fn over size bytes
+template <typename Fn>
+static Result measure(size_t size, Fn fn) {
+    Result best = {0, 0};
+    
+    for (int round = 0; round < 5; round++) {
+        unsigned long long t0 = ticks();
+        auto start = std::chrono::steady_clock::now();
+        if (!fn()) {
+            return {0, 0};
+        }
+        std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+        unsigned long long t1 = ticks();
+        double mbs = size / took.count() / 1e6;
+        if (mbs > best.mbs) {
+            best = {mbs, static_cast<double>(t1 - t0) / size};
+        }
+    }
+    return best;
+}
+
+// Run program with args on path, as an argument or piped into its stdin,
+// with its output thrown away
+static bool runProgram(const std::vector<const char*>& args, const std::string& path,
+                       const std::string& text, bool piped) {
+    std::vector<const char*> argv(args);
+    int fds[2] = {-1, -1};
+    
+    if (!piped) {
+        argv.push_back(path.c_str());
+    } else if (pipe(fds) < 0) {
+        return false;
+    }
+    argv.push_back(nullptr);
+    
+    pid_t pid = fork();
+    if (pid < 0) {
+        if (piped) {
+            close(fds[0]);
+            close(fds[1]);
+        }
+        return false;
+    }
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd < 0 || dup2(null_fd, STDOUT_FILENO) < 0) {
+            _exit(127);
+        }
+        if (null_fd != STDOUT_FILENO) {
+            close(null_fd);
+        }
+        if (piped) {
+            if (dup2(fds[0], STDIN_FILENO) < 0) {
+                _exit(127);
+            }
+            close(fds[0]);
+            close(fds[1]);
+        }
+        execv(argv[0], const_cast<char* const*>(argv.data()));
+        _exit(127);
+    }
+    if (piped) {
+        close(fds[0]);
+        for (size_t done = 0; done < text.size();) {
+            ssize_t n = write(fds[1], text.data() + done, text.size() - done);
+            if (n <= 0) {
+                break;
+            }
+            done += static_cast<size_t>(n);
+        }
+        close(fds[1]);
+    }
+    
+    int status;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Words to build corpora from; the UTF-8 ones cover two and three byte
+// sequences and mappings that grow (ß, ΐ)
+static const char* const ascii_words[] = {
+    "the", "Quick", "brown", "FOX", "jumps", "over", "lazy", "dog", "id=42,", "path/to/file.txt",
+    "Lorem", "ipsum", "dolor", "sit", "amet;", "HTTP/1.1", "200", "OK", "x", "ConfigValue"
+};
+static const char* const utf8_words[] = {
+    "Қазақстан", "Республикасы", "Алматы", "Съешь", "ещё", "мягких", "Ξεσκεπάζω", "ψυχοφθόρα",
+    "ΐ", "Grüße", "Straße", "Köln", "İstanbul", "ǆungla", "naïve", "café", "日本語", "ﬁle"
+};
+
+// size bytes of words, lines of min_line to max_line bytes ended by eol;
+// mixed takes every third word from the UTF-8 list
+static std::string makeCorpus(size_t size, bool mixed, size_t min_line, size_t max_line, const char* eol) {
+    std::mt19937 rng(2025);
+    std::string text;
+    
+    text.reserve(size + max_line);
+    while (text.size() < size) {
+        size_t line = min_line + rng() % (max_line - min_line + 1);
+        size_t start = text.size();
+        while (text.size() - start < line) {
+            if (text.size() > start) {
+                text += ' ';
+            }
+            if (mixed && rng() % 3 == 0) {
+                text += utf8_words[rng() % (sizeof(utf8_words) / sizeof(utf8_words[0]))];
+            } else {
+                text += ascii_words[rng() % (sizeof(ascii_words) / sizeof(ascii_words[0]))];
+            }
+        }
+        text += eol;
+    }
+    return text;
+}
+
+static void printResult(const Result& r) {
+    if (r.mbs == 0) {
+        std::printf(" %8s %6s", "failed", "");
+    } else if (r.cpb == 0) {
+        std::printf(" %8.0f %6s", r.mbs, "-");
+    } else {
+        std::printf(" %8.0f %6.2f", r.mbs, r.cpb);
+    }
+}
+
+template <ucase_mode Mode>
+static void benchMode(const char* name, const std::string& text, const std::string& path,
+                      const std::vector<const char*>& program) {
+    std::vector<char> out(text.size() * UCASE_MAX_GROWTH);
+    
+    std::printf("  %-8s", name);
+    printResult(measure(text.size(), [&] { return CaseEngine<Mode>::template convertBuffer<false>(text.data(), text.size(), out.data()) > 0; }));
+    printResult(measure(text.size(), [&] { return CaseEngine<Mode>::template convertBuffer<true>(text.data(), text.size(), out.data()) > 0; }));
+    printResult(measure(text.size(), [&] { return runProgram(program, path, text, false); }));
+    printResult(measure(text.size(), [&] { return runProgram(program, path, text, true); }));
+    std::printf("\n");
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s SIZE_MB BINDIR WORKDIR\n", argv[0]);
+        return 1;
+    }
+    size_t size = std::strtoul(argv[1], nullptr, 10) << 20;
+    std::string upper = std::string(argv[2]) + "/upper";
+    std::string lower = std::string(argv[2]) + "/lower";
+    std::string path = std::string(argv[3]) + "/corpus";
+    
+    static const struct {
+        const char* name;
+        bool mixed;
+        size_t min_line, max_line;
+        const char* eol;
+    } corpora[] = {
+        {"ascii", false, 40, 120, "\n"},
+        {"utf8", true, 40, 120, "\n"},
+        {"short", true, 1, 8, "\n"},
+        {"long", true, 1 << 20, 1 << 20, "\n"},
+        {"crlf", false, 40, 120, "\r\n"}
+    };
+    
+    signal(SIGPIPE, SIG_IGN);
+    std::printf("%-10s %15s %15s %15s %15s\n", "", "scalar", "simd", "mmap", "pipe");
+    std::printf("%-10s", "");
+    for (int i = 0; i < 4; i++) {
+        std::printf(" %8s %6s", "MB/s", "c/B");
+    }
+    std::printf("\n");
+    
+    for (const auto& corpus : corpora) {
+        std::string text = makeCorpus(size, corpus.mixed, corpus.min_line, corpus.max_line, corpus.eol);
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (!f || std::fwrite(text.data(), 1, text.size(), f) != text.size() || std::fclose(f) != 0) {
+            std::fprintf(stderr, "cannot write %s\n", path.c_str());
+            return 1;
+        }
+        
+        std::printf("%s\n", corpus.name);
+        benchMode<UCASE_UPPER>("upper", text, path, {upper.c_str(), "-j", "1"});
+        benchMode<UCASE_LOWER>("lower", text, path, {lower.c_str(), "-j", "1"});
+        benchMode<UCASE_TITLE>("title", text, path, {upper.c_str(), "-j", "1", "-T"});
+        benchMode<UCASE_SWAP>("swap", text, path, {upper.c_str(), "-j", "1", "-S"});
+        benchMode<UCASE_FOLD>("fold", text, path, {upper.c_str(), "-j", "1", "-F"});
+    }
+    unlink(path.c_str());
+    return 0;
+}
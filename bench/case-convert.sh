@@ -0,0 +1,34 @@
+#!/bin/bash
+#
+# case-convert.sh - QCO MoreUtils upper/lower throughput benchmark
+# Copyright 2025 AnmiTaliDev
+# Licensed under the Apache License, Version 2.0
+#
+# Builds case-convert.cpp and runs every case mode over pure ASCII, mixed
+# UTF-8, short line, long line and CRLF corpora, comparing the conversion
+# step of case_engine.h, with scalar and with SIMD ASCII loops, against
+# the mmap and pipe paths of bin/upper and bin/lower (on one thread).
+# Reports MB/s and cycles per byte. Set SIZE_MB to change the corpus size
+# (default 64).
+#
+
+set -e
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+CXX="${CXX:-g++}"
+SIZE_MB="${SIZE_MB:-64}"
+
+for util in upper lower; do
+    if [ ! -x "$ROOT_DIR/bin/$util" ]; then
+        echo "case-convert: $ROOT_DIR/bin/$util not found, run ./make $util first" >&2
+        exit 1
+    fi
+done
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+"$CXX" -O3 -pthread -o "$WORK_DIR/case-convert" "$ROOT_DIR/bench/case-convert.cpp"
+
+echo "Case conversion, ${SIZE_MB} MiB per corpus"
+"$WORK_DIR/case-convert" "$SIZE_MB" "$ROOT_DIR/bin" "$WORK_DIR"
@@ -0,0 +1,25 @@
+#!/bin/bash
+#
+# case-tables.sh - QCO MoreUtils Unicode case mapping benchmark
+# Copyright 2025 AnmiTaliDev
+# Licensed under the Apache License, Version 2.0
+#
+# Builds case-tables.cpp and compares upper-casing Kazakh, Russian, Greek
+# and mixed UTF-8 text through the compile-time tables of unicode_case.h
+# with the std::ctype<wchar_t> locale facet. Set SIZE_MB to change the
+# corpus size (default 64).
+#
+
+set -e
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+CXX="${CXX:-g++}"
+SIZE_MB="${SIZE_MB:-64}"
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+"$CXX" -O3 -o "$WORK_DIR/case-tables" "$ROOT_DIR/bench/case-tables.cpp"
+
+echo "Code point case mapping, ${SIZE_MB} MiB per corpus"
+"$WORK_DIR/case-tables" "$SIZE_MB"
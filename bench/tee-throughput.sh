@@ -0,0 +1,52 @@
+#!/bin/bash
+#
+# tee-throughput.sh - QCO MoreUtils tee buffer size benchmark
+# Copyright 2025 AnmiTaliDev
+# Licensed under the Apache License, Version 2.0
+#
+# Feeds a regular file through tee's read/write path with several buffer
+# sizes and reports MB/s with standard output going to a pipe, a file and
+# /dev/null. Set SIZE_MB to change the input size (default 512).
+#
+
+set -e
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+TEE="$ROOT_DIR/bin/tee"
+SIZE_MB="${SIZE_MB:-512}"
+
+if [ ! -x "$TEE" ]; then
+    echo "tee-throughput: $TEE not found, run ./make tee first" >&2
+    exit 1
+fi
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+head -c "$((SIZE_MB * 1024 * 1024))" /dev/zero > "$WORK_DIR/input"
+
+# Print the throughput of one command line in MB/s
+measure() {
+    local start end
+    start=$(date +%s%N)
+    eval "$1"
+    end=$(date +%s%N)
+    awk -v mb="$SIZE_MB" -v ns="$((end - start))" 'BEGIN { printf "%10.0f", mb / (ns / 1e9) }'
+}
+
+echo "tee read/write path, ${SIZE_MB} MiB input, one file output (MB/s)"
+printf "%-10s %10s %10s %10s\n" "buffer" "pipe" "file" "/dev/null"
+
+for size in 4K 64K 1M 4M adaptive; do
+    if [ "$size" = "adaptive" ]; then
+        opts=""
+    else
+        opts="-b $size"
+    fi
+
+    printf "%-10s" "$size"
+    measure "\"$TEE\" $opts \"$WORK_DIR/copy\" < \"$WORK_DIR/input\" | cat > /dev/null"
+    measure "\"$TEE\" $opts \"$WORK_DIR/copy\" < \"$WORK_DIR/input\" > \"$WORK_DIR/stdout\""
+    measure "\"$TEE\" $opts \"$WORK_DIR/copy\" < \"$WORK_DIR/input\" > /dev/null"
+    echo
+done
@@ -0,0 +1,60 @@
+#!/bin/bash
+#
+# tee-uring.sh - QCO MoreUtils tee io_uring benchmark
+# Copyright 2025 AnmiTaliDev
+# Licensed under the Apache License, Version 2.0
+#
+# Copies a regular file into 1, 8 and 64 output files with the default
+# read/write path and with --io-uring, and reports MB/s together with the
+# number of system calls each path made (taken from tee --verbose). Set
+# SIZE_MB to change the input size (default 256).
+#
+
+set -e
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+TEE="$ROOT_DIR/bin/tee"
+SIZE_MB="${SIZE_MB:-256}"
+
+if [ ! -x "$TEE" ]; then
+    echo "tee-uring: $TEE not found, run ./make tee first" >&2
+    exit 1
+fi
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+head -c "$((SIZE_MB * 1024 * 1024))" /dev/zero > "$WORK_DIR/input"
+
+# Run tee once; print MB/s and the syscall count from its verbose summary
+measure() {
+    local outputs="$1"
+    shift
+    local files=() start end log
+
+    for ((i = 0; i < outputs; i++)); do
+        files+=("$WORK_DIR/out.$i")
+    done
+
+    start=$(date +%s%N)
+    log=$("$TEE" -v -b 256K "$@" "${files[@]}" < "$WORK_DIR/input" 2>&1 > /dev/null)
+    end=$(date +%s%N)
+    rm -f "${files[@]}"
+
+    awk -v mb="$SIZE_MB" -v ns="$((end - start))" '
+        /^read\/write:/ { calls = $2 + $6 }
+        /^io_uring:/    { calls = $7 + 1 }
+        END { printf "%10.0f %10d", mb / (ns / 1e9), calls }
+    ' <<< "$log"
+}
+
+echo "tee ${SIZE_MB} MiB into N files, 256 KiB chunks"
+printf "%-8s %10s %10s   %10s %10s\n" "outputs" "rw MB/s" "rw calls" "uring MB/s" "uring calls"
+
+for outputs in 1 8 64; do
+    printf "%-8s" "$outputs"
+    measure "$outputs"
+    printf "  "
+    measure "$outputs" --io-uring
+    echo
+done
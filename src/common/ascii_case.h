@@ -0,0 +1,206 @@
+/*
+ * ascii_case.h - vectorized ASCII case conversion
+ *
+ * Part of QCO MoreUtils package
+ *
+ * Copyright 2025 AnmiTaliDev
+ * Licensed under the Apache License, Version 2.0
+ *
+ * ascii_case() converts the letters of a run of ASCII text 16 (SSE2) or
+ * 32 (AVX2) bytes per step, picking the widest kernel the CPU supports
+ * on first use. It stops at the first byte >= 0x80 and returns how far
+ * it got, so the caller can decode that UTF-8 sequence its own way and
+ * call back in for the ASCII that follows. ascii_title() does the same
+ * for title case, which also depends on the byte before.
+ *
+ * In mixed text most runs are a word or two between UTF-8 sequences, too
+ * short for a vector step to pay for its setup and the indirect call, so
+ * both first take up to ASCII_CASE_HEAD bytes with the scalar loop and
+ * only hand what is left of a longer run to the kernel.
+ */
+
+ #ifndef QCO_ASCII_CASE_H
+ #define QCO_ASCII_CASE_H
+ 
+ #include <stddef.h>
+ 
+ #define ASCII_CASE_HEAD 16    /* bytes converted by the scalar loop first */
+ 
+ #if defined(__x86_64__) || defined(__i386__)
+ #include <immintrin.h>
+ #define ASCII_CASE_X86 1
+ #endif
+ 
+ enum ascii_case_dir {
+     ASCII_LOWER,
+     ASCII_UPPER,
+     ASCII_SWAP
+ };
+ 
+ typedef size_t (*ascii_case_fn)(const char *in, char *out, size_t n, enum ascii_case_dir dir);
+ 
+ static inline size_t ascii_case_scalar(const char *in, char *out, size_t n, enum ascii_case_dir dir) {
+     unsigned char first = dir == ASCII_LOWER ? 'A' : 'a';
+     unsigned char fold = dir == ASCII_SWAP ? 0x20 : 0;
+ 
+     for (size_t i = 0; i < n; i++) {
+         unsigned char c = (unsigned char)in[i];
+         if (c >= 0x80) {
+             return i;
+         }
+         out[i] = (char)((unsigned char)((c | fold) - first) < 26 ? c ^ 0x20 : c);
+     }
+     return n;
+ }
+ 
+ #ifdef ASCII_CASE_X86
+ 
+ /*
+  * Letters are found with one signed compare: adding 128 - first maps
+  * first..first+25 onto -128..-103 and every other byte above that. The
+  * case bit (0x20) is then flipped in exactly those lanes. For ASCII_SWAP
+  * the bit is set before the compare, so both cases count as letters.
+  */
+ __attribute__((target("sse2")))
+ static inline size_t ascii_case_sse2(const char *in, char *out, size_t n, enum ascii_case_dir dir) {
+     const __m128i shift = _mm_set1_epi8((char)(128 - (dir == ASCII_LOWER ? 'A' : 'a')));
+     const __m128i fold = _mm_set1_epi8(dir == ASCII_SWAP ? 0x20 : 0);
+     const __m128i limit = _mm_set1_epi8((char)(-128 + 26));
+     const __m128i flip = _mm_set1_epi8(0x20);
+     size_t i = 0;
+ 
+     for (; i + 16 <= n; i += 16) {
+         __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+         int high = _mm_movemask_epi8(x);
+         if (high) {
+             return i + ascii_case_scalar(in + i, out + i, (size_t)__builtin_ctz(high), dir);
+         }
+         __m128i letters = _mm_cmplt_epi8(_mm_add_epi8(_mm_or_si128(x, fold), shift), limit);
+         _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(x, _mm_and_si128(letters, flip)));
+     }
+     return i + ascii_case_scalar(in + i, out + i, n - i, dir);
+ }
+ 
+ __attribute__((target("avx2")))
+ static inline size_t ascii_case_avx2(const char *in, char *out, size_t n, enum ascii_case_dir dir) {
+     const __m256i shift = _mm256_set1_epi8((char)(128 - (dir == ASCII_LOWER ? 'A' : 'a')));
+     const __m256i fold = _mm256_set1_epi8(dir == ASCII_SWAP ? 0x20 : 0);
+     const __m256i limit = _mm256_set1_epi8((char)(-128 + 26));
+     const __m256i flip = _mm256_set1_epi8(0x20);
+     size_t i = 0;
+ 
+     for (; i + 32 <= n; i += 32) {
+         __m256i x = _mm256_loadu_si256((const __m256i *)(in + i));
+         unsigned int high = (unsigned int)_mm256_movemask_epi8(x);
+         if (high) {
+             return i + ascii_case_scalar(in + i, out + i, (size_t)__builtin_ctz(high), dir);
+         }
+         /* cmpgt(limit, v) is v < limit */
+         __m256i letters = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(_mm256_or_si256(x, fold), shift));
+         _mm256_storeu_si256((__m256i *)(out + i), _mm256_xor_si256(x, _mm256_and_si256(letters, flip)));
+     }
+     return i + ascii_case_sse2(in + i, out + i, n - i, dir);
+ }
+ 
+ /*
+  * Title case: a letter is upper-cased after a non-letter and lower-cased
+  * after a letter. "After a letter" is the letter mask shifted up one
+  * lane, with the last lane of the previous step carried into the first.
+  */
+ static inline size_t ascii_title_scalar(const char *in, char *out, size_t n, int *cased);
+ 
+ __attribute__((target("sse2")))
+ static inline size_t ascii_title_sse2(const char *in, char *out, size_t n, int *cased) {
+     const __m128i shift = _mm_set1_epi8((char)(128 - 'a'));
+     const __m128i limit = _mm_set1_epi8((char)(-128 + 26));
+     const __m128i bit = _mm_set1_epi8(0x20);
+     __m128i carry = _mm_cvtsi32_si128(*cased ? 0xFF : 0);
+     size_t i = 0;
+ 
+     for (; i + 16 <= n; i += 16) {
+         __m128i x = _mm_loadu_si128((const __m128i *)(in + i));
+         int high = _mm_movemask_epi8(x);
+         if (high) {
+             *cased = _mm_cvtsi128_si32(carry) & 1;
+             return i + ascii_title_scalar(in + i, out + i, (size_t)__builtin_ctz(high), cased);
+         }
+         __m128i letters = _mm_cmplt_epi8(_mm_add_epi8(_mm_or_si128(x, bit), shift), limit);
+         __m128i after = _mm_or_si128(_mm_slli_si128(letters, 1), carry);
+         __m128i cased_x = _mm_or_si128(_mm_andnot_si128(bit, x), _mm_and_si128(after, bit));
+         _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(x, _mm_and_si128(letters, _mm_xor_si128(x, cased_x))));
+         carry = _mm_srli_si128(letters, 15);
+     }
+     *cased = _mm_cvtsi128_si32(carry) & 1;
+     return i + ascii_title_scalar(in + i, out + i, n - i, cased);
+ }
+ 
+ #endif /* ASCII_CASE_X86 */
+ 
+ static inline size_t ascii_title_scalar(const char *in, char *out, size_t n, int *cased) {
+     int after = *cased;
+ 
+     for (size_t i = 0; i < n; i++) {
+         unsigned char c = (unsigned char)in[i];
+         if (c >= 0x80) {
+             *cased = after;
+             return i;
+         }
+         int letter = (unsigned char)((c | 0x20) - 'a') < 26;
+         out[i] = (char)(letter ? (c & 0xDF) | (after << 5) : c);
+         after = letter;
+     }
+     *cased = after;
+     return n;
+ }
+ 
+ static inline ascii_case_fn ascii_case_select(void) {
+ #ifdef ASCII_CASE_X86
+     __builtin_cpu_init();
+     if (__builtin_cpu_supports("avx2")) {
+         return ascii_case_avx2;
+     }
+     if (__builtin_cpu_supports("sse2")) {
+         return ascii_case_sse2;
+     }
+ #endif
+     return ascii_case_scalar;
+ }
+ 
+ /* Convert the ASCII letters of in[0..n) into out, which may be in itself,
+  * up to the first non-ASCII byte; returns the number of bytes done */
+ static inline size_t ascii_case(const char *in, char *out, size_t n, enum ascii_case_dir dir) {
+     static ascii_case_fn kernel = NULL;
+     ascii_case_fn fn;
+     size_t head = n < ASCII_CASE_HEAD ? n : ASCII_CASE_HEAD;
+     size_t done = ascii_case_scalar(in, out, head, dir);
+ 
+     if (done < head || done == n) {
+         return done;
+     }
+     fn = __atomic_load_n(&kernel, __ATOMIC_RELAXED);
+     if (!fn) {
+         /* Threads may get here together; they all store the same kernel */
+         fn = ascii_case_select();
+         __atomic_store_n(&kernel, fn, __ATOMIC_RELAXED);
+     }
+     return done + fn(in + done, out + done, n - done, dir);
+ }
+ 
+ /* Title case the ASCII of in[0..n) into out, which may be in itself, up to
+  * the first non-ASCII byte; *cased tells whether the byte before in[0]
+  * was a letter and is left telling the same of the last byte done */
+ static inline size_t ascii_title(const char *in, char *out, size_t n, int *cased) {
+ #ifdef ASCII_CASE_X86
+     size_t head = n < ASCII_CASE_HEAD ? n : ASCII_CASE_HEAD;
+     size_t done = ascii_title_scalar(in, out, head, cased);
+ 
+     if (done < head || done == n) {
+         return done;
+     }
+     return done + ascii_title_sse2(in + done, out + done, n - done, cased);
+ #else
+     return ascii_title_scalar(in, out, n, cased);
+ #endif
+ }
+ 
+ #endif /* QCO_ASCII_CASE_H */
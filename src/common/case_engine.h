@@ -0,0 +1,1201 @@
+/*
+ * case_engine.h - the case conversion engine behind upper and lower
+ *
+ * Part of QCO MoreUtils package
+ *
+ * Copyright 2025 AnmiTaliDev
+ * Licensed under the Apache License, Version 2.0
+ *
+ * C++ only. CaseEngine<Mode> converts input read in blocks with read(2)
+ * or mapped from a regular file, split into pieces that a pool of worker
+ * threads converts and writes back in order; every mode (upper, lower,
+ * title, swapcase, casefold) is its own instantiation. The per-line
+ * options are template parameters of the line loop as well, so each
+ * combination of first-char, first-word, strip and line numbers compiles
+ * to a loop with no option tests in it. With --fields only the selected fields of each
+ * line are converted, found with the scanner of field_scan.h, and the
+ * rest is never written to. caseMain() is the whole command line tool; the
+ * upper and lower programs only pass it their default mode and help text.
+ */
+
+#ifndef QCO_CASE_ENGINE_H
+#define QCO_CASE_ENGINE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ascii_case.h"
+#include "unicode_case.h"
+#include "field_scan.h"
+
+struct CaseOptions {
+    bool preserve_whitespace = true;
+    bool line_numbers = false;
+    bool only_first_char = false;
+    bool only_first_word = false;
+    std::string delimiter = "";
+    bool in_place = false;
+    bool out_files = false;     // write FILE to FILE.out
+    size_t jobs = 0;            // worker threads, 0 for one per CPU
+    std::vector<std::pair<size_t, size_t>> fields;  // 1-based, sorted, merged
+    char separator = '\t';
+    bool csv = false;           // fields may be in double quotes
+};
+
+// An input that could not be opened, reported without the "error:" prefix
+struct CaseOpenError : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+template <ucase_mode Mode>
+class CaseEngine {
+private:
+    static constexpr size_t BLOCK_SIZE = 1 << 20;           // read(2) size for pipes
+    static constexpr size_t PIECE_SIZE = 4 << 20;           // slice of a mapped file
+    
+    // Title case needs to know whether the previous code point was cased;
+    // the other modes map ASCII with the SIMD kernel
+    static constexpr bool TITLE = Mode == UCASE_TITLE;
+    static constexpr ascii_case_dir ASCII_DIR =
+        Mode == UCASE_UPPER ? ASCII_UPPER : Mode == UCASE_SWAP ? ASCII_SWAP : ASCII_LOWER;
+    
+    // Convert the lines of data[0..len), each but perhaps the last ended by
+    // a newline, onto out; returns the number of the line after them
+    using LinesFn = size_t (CaseEngine::*)(const char*, size_t, size_t, std::string&) const;
+    
+    struct Job;
+    
+    // A slice of one input converted by one worker: part of a mapped file,
+    // or a block read from a pipe into its own buffer. Slices end after a
+    // newline when lines matter, otherwise between UTF-8 sequences.
+    struct Piece {
+        Job* job;
+        size_t seq;             // place in the order of its output
+        char* data;
+        size_t len;
+        bool writable;          // data may be converted where it lies
+        bool final_newline;     // the input ends here without one
+        size_t first_line;
+        bool cased;
+        const char* head;       // converted bytes: in place in data, or in buf
+        size_t head_len;
+        std::string out;        // converted output that follows them
+        std::unique_ptr<char[]> buf;
+        size_t buf_size = 0;
+        std::vector<char> block;    // the bytes of a piece that was read
+    };
+    
+    // Where converted pieces go: stdout, shared by all inputs, or a file of
+    // one input's own. Pieces finish in any order; the one that completes
+    // the next sequence number writes it and every finished one after it.
+    struct Output {
+        int fd;
+        std::mutex mutex;
+        size_t submitted = 0;
+        size_t written = 0;
+        std::vector<Piece*> ring;   // finished pieces by seq % window
+    };
+    
+    // One input argument; the last of its pieces to be written closes it
+    struct Job {
+        std::string name;
+        int fd = -1;
+        char* map = nullptr;
+        size_t size = 0;
+        size_t released = 0;        // mapped bytes already written
+        Output* output;
+        std::unique_ptr<Output> own;
+        std::string tmp;            // renamed over name once written (-i)
+        size_t pieces = 0;
+        size_t done = 0;
+        bool sealed = false;        // all pieces submitted
+        bool broken = false;        // stopped by an error; not renamed
+    };
+    
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Piece*> queue;
+    };
+    
+    LinesFn lines;
+    bool line_mode;             // any per-line option, or a delimiter
+    bool records;               // pieces end after a newline
+    bool line_numbers;
+    std::string line_end;
+    std::vector<std::pair<size_t, size_t>> fields;
+    char separator;
+    bool csv;
+    size_t jobs;
+    size_t window;              // pieces in flight, which bounds memory
+    size_t page;
+    
+    std::unique_ptr<Worker[]> workers;
+    std::vector<std::thread> threads;
+    std::mutex pool_mutex;
+    std::condition_variable pool_cond;
+    size_t queued = 0;          // pieces not yet taken by a worker
+    size_t next_worker = 0;
+    bool stopping = false;
+    
+    std::vector<std::unique_ptr<Piece>> pieces;
+    std::vector<Piece*> free_pieces;
+    std::mutex free_mutex;
+    std::condition_variable free_cond;
+    
+    std::mutex error_mutex;
+    std::exception_ptr error;   // the first one; later output is dropped
+    std::atomic<bool> failed{false};
+    
+    static bool asciiLetter(unsigned char c) {
+        return static_cast<unsigned char>((c | 0x20) - 'a') < 26;
+    }
+    
+    // Convert the ASCII in in[0..n) up to the first byte >= 0x80; Simd
+    // false keeps to the scalar loop, for comparison
+    template <bool Simd = true>
+    static size_t convertAscii(const char* in, char* out, size_t n, bool& cased) {
+        if constexpr (TITLE) {
+            int after = cased;
+            size_t run = Simd ? ascii_title(in, out, n, &after) : ascii_title_scalar(in, out, n, &after);
+            cased = after;
+            return run;
+        } else {
+            return Simd ? ascii_case(in, out, n, ASCII_DIR) : ascii_case_scalar(in, out, n, ASCII_DIR);
+        }
+    }
+    
+    // Decode one UTF-8 sequence from in[0..n), write its converted form to
+    // out; returns the bytes consumed and sets written. Malformed bytes
+    // are copied through one at a time.
+    static size_t convertCodePoint(const char* in, size_t n, char* out, size_t& written, bool& cased) {
+        char32_t cp;
+        size_t len = ucase_decode(reinterpret_cast<const unsigned char*>(in), n, cp);
+        
+        if (len == 0) {
+            out[0] = in[0];
+            written = 1;
+            cased = false;
+            return 1;
+        }
+        if constexpr (TITLE) {
+            written = cased ? ucase_map<UCASE_LOWER>(cp, out) : ucase_map<UCASE_TITLE>(cp, out);
+            cased = ucase_cased(cp);
+        } else {
+            written = ucase_map<Mode>(cp, out);
+        }
+        return len;
+    }
+    
+    // Convert in[0..n) into out, ASCII runs at a time and anything else one
+    // code point at a time, stopping after limit input bytes. consumed
+    // tells how much of in was used; the return value is the output length.
+    // Mappings such as U+0390 to three code points grow a sequence, so out
+    // needs UCASE_MAX_GROWTH * n bytes, unless fit is set: conversion then
+    // stops before the first code point whose converted form is longer than
+    // its source, so out needs n bytes and may be in itself.
+    template <bool Simd = true>
+    static size_t convert(const char* in, size_t n, char* out, size_t& consumed, bool& cased,
+                          bool fit = false, size_t limit = SIZE_MAX) {
+        size_t i = 0, o = 0;
+        size_t end = std::min(n, limit);
+        
+        while (i < end) {
+            size_t run = convertAscii<Simd>(in + i, out + o, end - i, cased);
+            i += run;
+            o += run;
+            if (i < end) {
+                char mapped[UCASE_MAX_BYTES];
+                size_t written;
+                bool next = cased;
+                size_t used = convertCodePoint(in + i, n - i, mapped, written, next);
+                if (fit && written > used) {
+                    break;
+                }
+                std::memcpy(out + o, mapped, written);
+                cased = next;
+                i += used;
+                o += written;
+            }
+        }
+        consumed = i;
+        return o;
+    }
+    
+    template <bool FirstChar, bool FirstWord, bool Strip, bool Numbers>
+    size_t convertLines(const char* data, size_t len, size_t line_num, std::string& out) const {
+        const char* end = data + len;
+        
+        while (data < end) {
+            const char* nl = static_cast<const char*>(std::memchr(data, '\n', end - data));
+            size_t n = (nl ? nl : end) - data;
+            size_t consumed, o;
+            bool cased = false;
+            
+            if constexpr (Numbers) {
+                char number[24];
+                char* stop = std::to_chars(number, number + sizeof(number), line_num).ptr;
+                out.append(number, stop - number);
+                out += ": ";
+            }
+            
+            size_t start = out.size();
+            out.resize(start + n * UCASE_MAX_GROWTH);
+            char* line = &out[start];
+            if constexpr (FirstChar) {
+                o = convert(data, n, line, consumed, cased, false, 1);
+                std::memcpy(line + o, data + consumed, n - consumed);
+                o += n - consumed;
+            } else if constexpr (FirstWord) {
+                // The first letter of the line, as before
+                std::memcpy(line, data, n);
+                char* letter = std::find_if(line, line + n, [](char c) { return asciiLetter(c); });
+                if (letter != line + n) {
+                    convertAscii(letter, letter, 1, cased);
+                }
+                o = n;
+            } else {
+                o = convert(data, n, line, consumed, cased);
+            }
+            
+            if constexpr (Strip) {
+                // Remove leading/trailing whitespace
+                static const char blanks[] = " \t\n\r\f\v";
+                char* first = line;
+                char* last = line + o;
+                while (first < last && std::memchr(blanks, *first, sizeof(blanks) - 1)) {
+                    first++;
+                }
+                while (last > first && std::memchr(blanks, last[-1], sizeof(blanks) - 1)) {
+                    last--;
+                }
+                std::memmove(line, first, last - first);
+                o = last - first;
+            }
+            
+            out.resize(start + o);
+            out += line_end;
+            data += nl ? n + 1 : n;
+            line_num++;
+        }
+        return line_num;
+    }
+    
+    // All sixteen option combinations, indexed by first-char, first-word,
+    // strip and line numbers as bits 0 to 3
+    template <size_t... I>
+    static constexpr std::array<LinesFn, sizeof...(I)> linesTable(std::index_sequence<I...>) {
+        return {{&CaseEngine::convertLines<(I & 1) != 0, (I & 2) != 0, (I & 4) != 0, (I & 8) != 0>...}};
+    }
+    
+    // Where convertFields() stopped, for the call that carries on
+    struct FieldState {
+        size_t field = 1;
+        size_t range = 0;       // first of fields not ending before field
+        size_t pending = 0;     // what is left of a selected field cut short
+        bool cased = false;
+    };
+    
+    // Convert the selected fields of the records in in[0..n) into out and
+    // copy the rest, which is left alone when out is in. With fit set this
+    // stops where convert() would, and st lets a second call pick up at
+    // consumed. A line is skipped in one scan once no selected field is
+    // left in it.
+    size_t convertFields(const char* in, size_t n, char* out, size_t& consumed, FieldState& st, bool fit) const {
+        size_t i = 0, o = 0;
+        
+        while (i < n) {
+            if (st.pending > 0) {
+                size_t used;
+                o += convert(in + i, st.pending, out + o, used, st.cased, fit);
+                i += used;
+                st.pending -= used;
+                if (st.pending > 0) {
+                    break;
+                }
+            } else if (st.range < fields.size() && st.field >= fields[st.range].first) {
+                st.pending = field_end(in + i, n - i, separator, csv);
+                st.cased = false;
+                if (st.pending > 0) {
+                    continue;
+                }
+            } else {
+                size_t len;
+                if (st.range < fields.size()) {
+                    len = field_end(in + i, n - i, separator, csv);
+                } else {
+                    size_t end = field_record_end(in + i, n - i, 0, csv);
+                    len = end ? end - 1 : n - i;
+                }
+                if (out + o != in + i) {
+                    std::memmove(out + o, in + i, len);
+                }
+                i += len;
+                o += len;
+            }
+            
+            // At the separator or newline after the field
+            if (i < n) {
+                out[o++] = in[i];
+                if (in[i++] == '\n') {
+                    st.field = 1;
+                    st.range = 0;
+                } else {
+                    st.field++;
+                    while (st.range < fields.size() && fields[st.range].second < st.field) {
+                        st.range++;
+                    }
+                }
+            }
+        }
+        consumed = i;
+        return o;
+    }
+    
+    static void writeAll(int fd, const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = write(fd, data, len);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("write error: ") + strerror(errno));
+            }
+            data += n;
+            len -= static_cast<size_t>(n);
+        }
+    }
+    
+    // Read into buf[held..], returning the bytes read (0 at end of input)
+    static size_t readSome(int fd, char* buf, size_t len) {
+        for (;;) {
+            ssize_t n = read(fd, buf, len);
+            if (n >= 0) {
+                return static_cast<size_t>(n);
+            }
+            if (errno != EINTR) {
+                throw std::runtime_error(std::string("read error: ") + strerror(errno));
+            }
+        }
+    }
+    
+    // Offset in buf[0..len) before a UTF-8 sequence cut off at the end
+    static size_t completeSequences(const char* buf, size_t len) {
+        for (size_t back = 1; back <= 3 && back <= len; back++) {
+            unsigned char c = static_cast<unsigned char>(buf[len - back]);
+            if ((c & 0xC0) != 0x80) {
+                size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+                return need > back ? len - back : len;
+            }
+        }
+        return len;
+    }
+    
+    // Whether the code point that ends at data[pos] is cased, for a title
+    // case conversion starting there
+    static bool casedBefore(const char* data, size_t pos) {
+        size_t start = pos;
+        char32_t cp;
+        
+        if (pos == 0) {
+            return false;
+        }
+        if (static_cast<unsigned char>(data[pos - 1]) < 0x80) {
+            return asciiLetter(data[pos - 1]);
+        }
+        while (start > 0 && pos - start < 4) {
+            start--;
+            if ((data[start] & 0xC0) != 0x80) {
+                break;
+            }
+        }
+        size_t len = ucase_decode(reinterpret_cast<const unsigned char*>(data + start), pos - start, cp);
+        return len == pos - start && len > 0 && ucase_cased(cp);
+    }
+    
+    // Offset after the last complete line, or CSV record, of data[0..len)
+    size_t recordsEnd(const char* data, size_t len) const {
+        size_t end = 0, next;
+        
+        if (!csv) {
+            const char* nl = static_cast<const char*>(memrchr(data, '\n', len));
+            return nl ? nl - data + 1 : 0;
+        }
+        while ((next = field_record_end(data + end, len - end, 0, 1)) > 0) {
+            end += next;
+        }
+        return end;
+    }
+    
+    // Where the piece starting at start should end: after a newline when
+    // lines matter, otherwise anywhere that does not split a UTF-8 sequence
+    size_t pieceEnd(const char* data, size_t size, size_t start) const {
+        size_t end = start + PIECE_SIZE;
+        
+        if (end >= size) {
+            return size;
+        }
+        if (records) {
+            size_t next = field_record_end(data + start, size - start, PIECE_SIZE, csv);
+            return next ? start + next : size;
+        }
+        for (int back = 0; back < 3 && (data[end] & 0xC0) == 0x80; back++) {
+            end--;
+        }
+        return end;
+    }
+    
+    // Convert a piece where it lies when it is writable, otherwise into its
+    // own reused buffer; only what a growing mapping adds goes to out
+    void convertPiece(Piece& p) const {
+        size_t consumed = 0;
+        
+        p.out.clear();
+        p.head_len = 0;
+        if (line_mode) {
+            (this->*lines)(p.data, p.len, p.first_line, p.out);
+            return;
+        }
+        
+        if (p.writable) {
+            p.head = p.data;
+        } else {
+            if (p.buf_size < p.len) {
+                p.buf_size = std::max(p.len, PIECE_SIZE);
+                p.buf.reset(new char[p.buf_size]);
+            }
+            p.head = p.buf.get();
+        }
+        char* head = const_cast<char*>(p.head);
+        size_t rest;
+        if (fields.empty()) {
+            p.head_len = convert(p.data, p.len, head, consumed, p.cased, true);
+            if (consumed < p.len) {
+                p.out.resize((p.len - consumed) * UCASE_MAX_GROWTH);
+                p.out.resize(convert(p.data + consumed, p.len - consumed, &p.out[0], rest, p.cased));
+            }
+        } else {
+            FieldState st;
+            p.head_len = convertFields(p.data, p.len, head, consumed, st, true);
+            if (consumed < p.len) {
+                p.out.resize((p.len - consumed) * UCASE_MAX_GROWTH);
+                p.out.resize(convertFields(p.data + consumed, p.len - consumed, &p.out[0], rest, st, false));
+            }
+        }
+        
+        // Like getline(), every line ends in a newline on output
+        if (p.final_newline) {
+            p.out += '\n';
+        }
+    }
+    
+    void record(std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+            error = e;
+        }
+    }
+    
+    // A conversion or write error: whatever would follow it is dropped
+    void fail(std::exception_ptr e) {
+        record(e);
+        failed = true;
+    }
+    
+    Piece* acquire() {
+        std::unique_lock<std::mutex> lock(free_mutex);
+        free_cond.wait(lock, [this] { return !free_pieces.empty(); });
+        Piece* p = free_pieces.back();
+        free_pieces.pop_back();
+        return p;
+    }
+    
+    void release(Piece* p) {
+        {
+            std::lock_guard<std::mutex> lock(free_mutex);
+            free_pieces.push_back(p);
+        }
+        free_cond.notify_one();
+    }
+    
+    // Give a piece the next place in its output and queue it on the next
+    // worker in turn
+    void submit(Piece* p) {
+        Output& out = *p->job->output;
+        {
+            std::lock_guard<std::mutex> lock(out.mutex);
+            p->seq = out.submitted++;
+            p->job->pieces++;
+        }
+        Worker& w = workers[next_worker++ % jobs];
+        {
+            std::lock_guard<std::mutex> lock(w.mutex);
+            w.queue.push_back(p);
+        }
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            queued++;
+        }
+        pool_cond.notify_one();
+    }
+    
+    // A worker takes the oldest piece of its own queue, or when that is
+    // empty steals the newest of another's. Taking one off queued first
+    // reserves it, so the search always finds a piece.
+    void work(size_t self) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(pool_mutex);
+                pool_cond.wait(lock, [this] { return queued > 0 || stopping; });
+                if (queued == 0) {
+                    return;
+                }
+                queued--;
+            }
+            
+            Piece* p = nullptr;
+            for (size_t k = 0; !p; k++) {
+                Worker& w = workers[(self + k) % jobs];
+                std::lock_guard<std::mutex> lock(w.mutex);
+                if (w.queue.empty()) {
+                    continue;
+                }
+                if (k == 0) {
+                    p = w.queue.front();
+                    w.queue.pop_front();
+                } else {
+                    p = w.queue.back();
+                    w.queue.pop_back();
+                }
+            }
+            
+            if (!failed) {
+                try {
+                    convertPiece(*p);
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+            deliver(p);
+        }
+    }
+    
+    // The reorder buffer: park a finished piece in its output's ring, then
+    // write whatever run of pieces is now complete from the next in order
+    void deliver(Piece* p) {
+        Output& out = *p->job->output;
+        std::lock_guard<std::mutex> lock(out.mutex);
+        
+        out.ring[p->seq % window] = p;
+        while (Piece* q = out.ring[out.written % window]) {
+            Job* job = q->job;
+            out.ring[out.written % window] = nullptr;
+            out.written++;
+            if (!failed) {
+                try {
+                    writeAll(out.fd, q->head, q->head_len);
+                    writeAll(out.fd, q->out.data(), q->out.size());
+                } catch (...) {
+                    fail(std::current_exception());
+                }
+            }
+            
+            // Written pages are not needed again
+            if (job->map) {
+                size_t done = static_cast<size_t>(q->data + q->len - job->map) / page * page;
+                if (done > job->released) {
+                    madvise(job->map + job->released, done - job->released, MADV_DONTNEED);
+                    job->released = done;
+                }
+            }
+            job->done++;
+            release(q);
+            if (job->sealed && job->done == job->pieces) {
+                finish(job);
+            }
+        }
+    }
+    
+    // Called with the job's output locked once all its pieces are written
+    void finish(Job* job) {
+        if (job->map) {
+            munmap(job->map, job->size);
+            job->map = nullptr;
+        }
+        if (job->fd > STDIN_FILENO) {
+            close(job->fd);
+        }
+        job->fd = -1;
+        if (!job->own) {
+            return;
+        }
+        
+        int res = close(job->own->fd);
+        if (!failed && res < 0) {
+            fail(std::make_exception_ptr(std::runtime_error(std::string("write error: ") + strerror(errno))));
+        }
+        if (!job->tmp.empty()) {
+            if (failed || job->broken) {
+                unlink(job->tmp.c_str());
+            } else if (rename(job->tmp.c_str(), job->name.c_str()) < 0) {
+                fail(std::make_exception_ptr(std::runtime_error(
+                    "cannot replace '" + job->name + "': " + strerror(errno))));
+                unlink(job->tmp.c_str());
+            }
+        }
+    }
+    
+    void seal(Job* job, bool broken) {
+        std::lock_guard<std::mutex> lock(job->output->mutex);
+        job->sealed = true;
+        job->broken = broken;
+        if (job->done == job->pieces) {
+            finish(job);
+        }
+    }
+    
+    // Number the lines of a piece and, for title case, find out whether
+    // its last code point is cased. Done before the piece is queued, so
+    // nothing has converted its bytes yet.
+    void prepare(Piece* p, size_t& line_num, bool& cased) const {
+        p->first_line = line_num;
+        if (line_numbers) {
+            line_num += std::count(p->data, p->data + p->len, '\n');
+        }
+        p->cased = cased;
+        if (TITLE && !records && p->len > 0) {
+            cased = casedBefore(p->data, p->len);
+        }
+    }
+    
+    // Regular files are converted straight from a mapping of the whole
+    // file. For -i the mapping is private and writable and the pieces are
+    // converted where they lie; otherwise each goes to its piece's buffer.
+    // Conversion starts at offset start, which the mapping need not (stdin
+    // may have been read from already), so it begins at the page before.
+    void produceMapped(Job* job, size_t size, size_t start, bool in_place) {
+        int prot = in_place ? PROT_READ | PROT_WRITE : PROT_READ;
+        size_t base = start / page * page;
+        size -= base;
+        char* data = static_cast<char*>(mmap(nullptr, size, prot, MAP_PRIVATE, job->fd, static_cast<off_t>(base)));
+        size_t pos = start - base, line_num = 1;
+        bool cased = false;
+        
+        if (data == MAP_FAILED) {
+            throw std::runtime_error(std::string("mmap failed: ") + strerror(errno));
+        }
+        madvise(data, size, MADV_SEQUENTIAL);
+        job->map = data;
+        job->size = size;
+        
+        while (pos < size && !failed) {
+            size_t end = pieceEnd(data, size, pos);
+            Piece* p = acquire();
+            p->job = job;
+            p->data = data + pos;
+            p->len = end - pos;
+            p->writable = in_place;
+            p->final_newline = end == size && !line_mode && data[size - 1] != '\n';
+            prepare(p, line_num, cased);
+            submit(p);
+            pos = end;
+        }
+    }
+    
+    // Anything else is read in blocks of complete lines (or records), or
+    // of complete UTF-8 sequences otherwise, each converted in place. What
+    // follows the last complete one is carried over to the next block; a
+    // line longer than a block grows it.
+    void produceRead(Job* job) {
+        std::vector<char> carry;
+        size_t line_num = 1;
+        bool cased = false;
+        char last = '\n';
+        
+        while (!failed) {
+            Piece* p = acquire();
+            std::vector<char>& block = p->block;
+            size_t held = carry.size();
+            size_t got = 0, ready = 0;
+            
+            try {
+                block.resize(std::max({block.size(), BLOCK_SIZE, held * 2}));
+                std::copy(carry.begin(), carry.end(), block.begin());
+                for (;;) {
+                    if (held == block.size()) {
+                        block.resize(block.size() * 2);
+                    }
+                    got = readSome(job->fd, &block[held], block.size() - held);
+                    if (got == 0) {
+                        ready = held;
+                    } else if (records) {
+                        ready = recordsEnd(&block[0], held + got);
+                    } else {
+                        ready = completeSequences(&block[0], held + got);
+                    }
+                    held += got;
+                    if (ready > 0 || got == 0) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                release(p);
+                throw;
+            }
+            carry.assign(block.begin() + ready, block.begin() + held);
+            
+            if (ready > 0) {
+                last = block[ready - 1];
+            }
+            p->job = job;
+            p->data = &block[0];
+            p->len = ready;
+            p->writable = true;
+            p->final_newline = got == 0 && !line_mode && last != '\n';
+            prepare(p, line_num, cased);
+            if (p->len > 0 || p->final_newline) {
+                submit(p);
+            } else {
+                release(p);
+            }
+            if (got == 0) {
+                break;
+            }
+        }
+    }
+    
+    // Open an input and where its output goes, then split it into pieces
+    void produce(Job* job, const CaseOptions& options) {
+        struct stat st;
+        off_t start = 0;
+        
+        if (job->name == "-") {
+            job->fd = STDIN_FILENO;
+            start = std::max<off_t>(lseek(job->fd, 0, SEEK_CUR), 0);
+        } else {
+            job->fd = open(job->name.c_str(), O_RDONLY);
+            if (job->fd < 0) {
+                throw CaseOpenError("cannot open '" + job->name + "': " + strerror(errno));
+            }
+        }
+        if (fstat(job->fd, &st) < 0) {
+            throw std::runtime_error("cannot stat '" + job->name + "': " + strerror(errno));
+        }
+        
+        if (options.in_place || options.out_files) {
+            int fd;
+            if (options.in_place) {
+                if (!S_ISREG(st.st_mode)) {
+                    throw std::runtime_error("'" + job->name + "' is not a regular file");
+                }
+                job->tmp = job->name + ".XXXXXX";
+                fd = mkstemp(&job->tmp[0]);
+                if (fd < 0) {
+                    job->tmp.clear();
+                    throw std::runtime_error("cannot create temporary file for '" + job->name + "': " +
+                                             strerror(errno));
+                }
+                fchmod(fd, st.st_mode & 07777);
+            } else {
+                std::string target = job->name + ".out";
+                fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+                if (fd < 0) {
+                    throw std::runtime_error("cannot create '" + target + "': " + strerror(errno));
+                }
+            }
+            job->own.reset(new Output);
+            job->own->fd = fd;
+            job->own->ring.assign(window, nullptr);
+            job->output = job->own.get();
+        }
+        
+        // Whatever is left of stdin is consumed as reading it would
+        if (S_ISREG(st.st_mode) && st.st_size > start) {
+            produceMapped(job, static_cast<size_t>(st.st_size), static_cast<size_t>(start), options.in_place);
+            if (job->fd == STDIN_FILENO) {
+                lseek(job->fd, 0, SEEK_END);
+            }
+        } else {
+            produceRead(job);
+        }
+    }
+
+public:
+    // The conversion the workers do, on its own: in[0..n) into out, which
+    // needs UCASE_MAX_GROWTH * n bytes; returns the output length. Simd
+    // false converts ASCII with the scalar loop. bench/case-convert.cpp
+    // measures it both ways.
+    template <bool Simd = true>
+    static size_t convertBuffer(const char* in, size_t n, char* out) {
+        size_t consumed;
+        bool cased = false;
+        
+        return convert<Simd>(in, n, out, consumed, cased);
+    }
+    
+    explicit CaseEngine(const CaseOptions& options) {
+        // -c wins over -w, as it always did
+        size_t index = (options.only_first_char ? 1 : 0) |
+                       (options.only_first_word && !options.only_first_char ? 2 : 0) |
+                       (!options.preserve_whitespace ? 4 : 0) |
+                       (options.line_numbers ? 8 : 0);
+        
+        lines = linesTable(std::make_index_sequence<16>())[index];
+        line_mode = index != 0 || !options.delimiter.empty();
+        line_numbers = options.line_numbers;
+        line_end = options.delimiter.empty() ? "\n" : options.delimiter;
+        fields = options.fields;
+        separator = options.separator;
+        csv = options.csv;
+        records = line_mode || !fields.empty();
+        jobs = options.jobs ? options.jobs : std::max(1u, std::thread::hardware_concurrency());
+        window = 2 * jobs + 2;
+        page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+    
+    // Convert the inputs ("-" is stdin) on a pool of jobs workers. The
+    // calling thread splits them into pieces in order and queues them; the
+    // pieces come back out in that order, so stdout is what one thread
+    // would have written. With -i or -o each input has an output of its
+    // own, and inputs finish in whatever order their pieces do.
+    void run(const std::vector<std::string>& inputs, const CaseOptions& options) {
+        Output shared;
+        std::vector<std::unique_ptr<Job>> all;
+        
+        shared.fd = STDOUT_FILENO;
+        shared.ring.assign(window, nullptr);
+        for (size_t i = 0; i < window; i++) {
+            pieces.emplace_back(new Piece);
+            free_pieces.push_back(pieces.back().get());
+        }
+        
+        workers.reset(new Worker[jobs]);
+        for (size_t i = 0; i < jobs; i++) {
+            threads.emplace_back(&CaseEngine::work, this, i);
+        }
+        
+        for (const auto& name : inputs) {
+            all.emplace_back(new Job);
+            Job* job = all.back().get();
+            job->name = name;
+            job->output = &shared;
+            
+            // Like the serial loop, stop at the first bad input, but let
+            // the pieces already queued be written
+            bool broken = false;
+            try {
+                produce(job, options);
+            } catch (...) {
+                record(std::current_exception());
+                broken = true;
+            }
+            seal(job, broken);
+            if (broken || failed) {
+                break;
+            }
+        }
+        
+        // Wait for every piece to be written, then for the workers
+        {
+            std::unique_lock<std::mutex> lock(free_mutex);
+            free_cond.wait(lock, [this] { return free_pieces.size() == window; });
+        }
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            stopping = true;
+        }
+        pool_cond.notify_all();
+        for (auto& t : threads) {
+            t.join();
+        }
+        
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+// What tells the upper and lower programs apart
+struct CaseTool {
+    const char* name;
+    ucase_mode mode;
+    const char* summary;
+    const char* examples[4][2];     // text before and after the program name
+};
+
+// Parse a cut(1) style list of fields such as 1,3-5,7- into sorted ranges,
+// overlapping ones merged; false if the list is not one
+inline bool caseParseFields(const char* list, std::vector<std::pair<size_t, size_t>>& ranges) {
+    const char* end = list + std::strlen(list);
+    
+    ranges.clear();
+    if (list < end && end[-1] == ',') {
+        return false;
+    }
+    while (list < end) {
+        size_t first = 1, last = SIZE_MAX;
+        const char* comma = std::find(list, end, ',');
+        const char* dash = std::find(list, comma, '-');
+        
+        if (comma == list || (dash == list && dash + 1 == comma)) {
+            return false;
+        }
+        if (dash > list && std::from_chars(list, dash, first).ptr != dash) {
+            return false;
+        }
+        if (dash == comma) {
+            last = first;
+        } else if (dash + 1 < comma && std::from_chars(dash + 1, comma, last).ptr != comma) {
+            return false;
+        }
+        if (first == 0 || last < first) {
+            return false;
+        }
+        ranges.emplace_back(first, last);
+        list = comma == end ? end : comma + 1;
+    }
+    if (ranges.empty()) {
+        return false;
+    }
+    
+    std::sort(ranges.begin(), ranges.end());
+    size_t merged = 0;
+    for (size_t i = 1; i < ranges.size(); i++) {
+        if (ranges[i].first <= ranges[merged].second ||
+            ranges[i].first - 1 == ranges[merged].second) {
+            ranges[merged].second = std::max(ranges[merged].second, ranges[i].second);
+        } else {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    ranges.resize(merged + 1);
+    return true;
+}
+
+inline void caseUsage(const CaseTool& tool, const char* program_name) {
+    std::cout << "Usage: " << program_name << " [OPTIONS] [FILE...]\n\n"
+              << tool.summary << "\n\n"
+              << "Options:\n"
+              << "  -c, --first-char     Convert only first character\n"
+              << "  -w, --first-word     Convert only first word\n"
+              << "  -n, --line-numbers   Show line numbers\n"
+              << "  -s, --strip          Strip leading/trailing whitespace\n"
+              << "  -d, --delimiter=STR  Use custom line delimiter\n"
+              << "  -i, --in-place       Rewrite the FILEs instead of printing them\n"
+              << "  -o, --out-files      Write each FILE to FILE.out instead of printing it\n"
+              << "  -j, --jobs=N         Convert on N threads (default: one per CPU)\n"
+              << "  -f, --fields=LIST    Convert only these fields, e.g. 2 or 1,3-5,7-\n"
+              << "  -t, --field-separator=C  Fields are separated by C (default: tab)\n"
+              << "      --csv            Fields are comma separated and may be quoted\n"
+              << "  -T, --title          Title case: capitalize each word, lower the rest\n"
+              << "  -S, --swapcase       Swap upper and lower case\n"
+              << "  -F, --casefold       Fold case for caseless comparison (ß -> ss)\n"
+              << "  -h, --help           Show this help message\n"
+              << "  -v, --version        Show version information\n\n"
+              << "Examples:\n";
+    for (const auto& example : tool.examples) {
+        std::cout << "  " << example[0] << program_name << example[1] << "\n";
+    }
+    std::cout << "\n"
+              << "Part of QCO MoreUtils by AnmiTaliDev\n"
+              << "Repository: https://github.com/Qainar-Projects/MoreUtils\n";
+}
+
+inline void caseVersion(const CaseTool& tool) {
+    std::cout << tool.name << " 1.0.0\n"
+              << "Part of QCO MoreUtils - Advanced System Development More Utilities\n"
+              << "Copyright 2025 AnmiTaliDev\n"
+              << "Licensed under the Apache License, Version 2.0\n"
+              << "Repository: https://github.com/Qainar-Projects/MoreUtils\n";
+}
+
+template <ucase_mode Mode>
+int caseRun(const CaseTool& tool, const CaseOptions& options, std::vector<std::string> input_files) {
+    CaseEngine<Mode> engine(options);
+    
+    if (input_files.empty()) {
+        // Read from stdin
+        if (isatty(STDIN_FILENO)) {
+            std::cerr << tool.name << ": reading from stdin (use Ctrl+D to end input)\n";
+        }
+        input_files.push_back("-");
+    }
+    
+    try {
+        engine.run(input_files, options);
+    } catch (const CaseOpenError& e) {
+        std::cerr << tool.name << ": " << e.what() << "\n";
+        return 1;
+    } catch (const std::exception& e) {
+        std::cerr << tool.name << ": error: " << e.what() << "\n";
+        return 1;
+    }
+    
+    return 0;
+}
+
+inline int caseMain(int argc, char* argv[], const CaseTool& tool) {
+    CaseOptions options;
+    ucase_mode mode = tool.mode;
+    std::vector<std::string> input_files;
+    bool separator_set = false;
+    
+    static struct option long_options[] = {
+        {"first-char",   no_argument,       0, 'c'},
+        {"first-word",   no_argument,       0, 'w'},
+        {"line-numbers", no_argument,       0, 'n'},
+        {"strip",        no_argument,       0, 's'},
+        {"delimiter",    required_argument, 0, 'd'},
+        {"in-place",     no_argument,       0, 'i'},
+        {"out-files",    no_argument,       0, 'o'},
+        {"jobs",         required_argument, 0, 'j'},
+        {"fields",       required_argument, 0, 'f'},
+        {"field-separator", required_argument, 0, 't'},
+        {"csv",          no_argument,       0, 6001},
+        {"title",        no_argument,       0, 'T'},
+        {"swapcase",     no_argument,       0, 'S'},
+        {"casefold",     no_argument,       0, 'F'},
+        {"help",         no_argument,       0, 'h'},
+        {"version",      no_argument,       0, 'v'},
+        {0, 0, 0, 0}
+    };
+    
+    int opt;
+    int option_index = 0;
+    
+    while ((opt = getopt_long(argc, argv, "cwnsd:ioj:f:t:TSFhv", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 'c':
+                options.only_first_char = true;
+                break;
+            case 'w':
+                options.only_first_word = true;
+                break;
+            case 'n':
+                options.line_numbers = true;
+                break;
+            case 's':
+                options.preserve_whitespace = false;
+                break;
+            case 'd':
+                options.delimiter = optarg;
+                break;
+            case 'i':
+                options.in_place = true;
+                break;
+            case 'o':
+                options.out_files = true;
+                break;
+            case 'j': {
+                const char* end = optarg + std::strlen(optarg);
+                auto res = std::from_chars(optarg, end, options.jobs);
+                if (res.ec != std::errc() || res.ptr != end || options.jobs == 0) {
+                    std::cerr << tool.name << ": invalid number of jobs: '" << optarg << "'\n";
+                    return 1;
+                }
+                break;
+            }
+            case 'f':
+                if (!caseParseFields(optarg, options.fields)) {
+                    std::cerr << tool.name << ": invalid field list: '" << optarg << "'\n";
+                    return 1;
+                }
+                break;
+            case 't':
+                if (std::strlen(optarg) != 1 || *optarg == '\n') {
+                    std::cerr << tool.name << ": the field separator must be a single character\n";
+                    return 1;
+                }
+                options.separator = *optarg;
+                separator_set = true;
+                break;
+            case 6001:
+                options.csv = true;
+                break;
+            case 'T':
+                mode = UCASE_TITLE;
+                break;
+            case 'S':
+                mode = UCASE_SWAP;
+                break;
+            case 'F':
+                mode = UCASE_FOLD;
+                break;
+            case 'h':
+                caseUsage(tool, argv[0]);
+                return 0;
+            case 'v':
+                caseVersion(tool);
+                return 0;
+            case '?':
+                std::cerr << "Try '" << argv[0] << " --help' for more information.\n";
+                return 1;
+            default:
+                return 1;
+        }
+    }
+    
+    // Collect input files
+    for (int i = optind; i < argc; i++) {
+        input_files.push_back(argv[i]);
+    }
+    
+    if (options.csv && !separator_set) {
+        options.separator = ',';
+    }
+    if ((options.csv || separator_set) && options.fields.empty()) {
+        std::cerr << tool.name << ": --field-separator and --csv need --fields\n";
+        return 1;
+    }
+    if (!options.fields.empty() && (options.only_first_char || options.only_first_word || options.line_numbers ||
+                                    !options.preserve_whitespace || !options.delimiter.empty())) {
+        std::cerr << tool.name << ": --fields cannot be combined with -c, -w, -n, -s or -d\n";
+        return 1;
+    }
+    if (options.in_place && options.out_files) {
+        std::cerr << tool.name << ": --in-place and --out-files cannot be combined\n";
+        return 1;
+    }
+    if ((options.in_place || options.out_files) &&
+        (input_files.empty() || std::find(input_files.begin(), input_files.end(), "-") != input_files.end())) {
+        std::cerr << tool.name << ": " << (options.in_place ? "--in-place" : "--out-files")
+                  << " needs file arguments other than '-'\n";
+        return 1;
+    }
+    
+    switch (mode) {
+        case UCASE_UPPER:
+            return caseRun<UCASE_UPPER>(tool, options, input_files);
+        case UCASE_LOWER:
+            return caseRun<UCASE_LOWER>(tool, options, input_files);
+        case UCASE_TITLE:
+            return caseRun<UCASE_TITLE>(tool, options, input_files);
+        case UCASE_FOLD:
+            return caseRun<UCASE_FOLD>(tool, options, input_files);
+        case UCASE_SWAP:
+            return caseRun<UCASE_SWAP>(tool, options, input_files);
+    }
+    return 1;
+}
+
+#endif /* QCO_CASE_ENGINE_H */
@@ -0,0 +1,463 @@
+/*
+ * gzip.h - streaming gzip writer
+ *
+ * Part of QCO MoreUtils package
+ *
+ * Copyright 2025 AnmiTaliDev
+ * Licensed under the Apache License, Version 2.0
+ *
+ * Compresses a byte stream into a gzip member (RFC 1952) and hands the
+ * output to a callback in pieces of up to GZIP_OUT_SIZE (zlib) or one
+ * block's worth (built-in). Built with -DHAVE_ZLIB it drives zlib's
+ * deflate; otherwise a built-in encoder is used: greedy LZ77 with one
+ * hash probe per position over the 32K window, emitted as fixed-Huffman
+ * deflate blocks, or as stored blocks where that would be larger (random
+ * or already compressed input). That is roughly what gzip -1 does minus
+ * the dynamic Huffman tables, so it is fast and still shrinks logs and
+ * captures by a good factor; it has that one level, and gzip_init()
+ * ignores the one asked for. A stream is used by one thread at a time,
+ * different streams by different threads at once.
+ */
+
+ #ifndef QCO_GZIP_H
+ #define QCO_GZIP_H
+ 
+ #include <stdint.h>
+ #include <stdlib.h>
+ #include <string.h>
+ #include <pthread.h>
+ 
+ #ifdef HAVE_ZLIB
+ #include <zlib.h>
+ #endif
+ 
+ #define GZIP_OUT_SIZE (64 * 1024)
+ 
+ /* Receives compressed output; returns 0, or -1 to abort the stream */
+ typedef int (*gzip_output_fn)(void *ctx, const char *data, size_t len);
+ 
+ #ifdef HAVE_ZLIB
+ 
+ struct gzip_stream {
+     z_stream z;
+     unsigned char *out;
+     unsigned long long bytes_in, bytes_out;
+ };
+ 
+ static inline const char *gzip_engine(void) {
+     return "zlib";
+ }
+ 
+ static inline int gzip_init(struct gzip_stream *g, int level) {
+     memset(g, 0, sizeof(*g));
+     g->out = (unsigned char *)malloc(GZIP_OUT_SIZE);
+     if (!g->out) {
+         return -1;
+     }
+     /* windowBits 15 + 16 selects the gzip wrapper */
+     if (deflateInit2(&g->z, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+         free(g->out);
+         g->out = NULL;
+         return -1;
+     }
+     return 0;
+ }
+ 
+ static inline int gzip_deflate(struct gzip_stream *g, int flush, gzip_output_fn fn, void *ctx) {
+     int ret;
+ 
+     do {
+         g->z.next_out = g->out;
+         g->z.avail_out = GZIP_OUT_SIZE;
+         ret = deflate(&g->z, flush);
+         if (ret == Z_STREAM_ERROR) {
+             return -1;
+         }
+         if (GZIP_OUT_SIZE - g->z.avail_out > 0) {
+             size_t n = GZIP_OUT_SIZE - g->z.avail_out;
+             if (fn(ctx, (const char *)g->out, n) < 0) {
+                 return -1;
+             }
+             g->bytes_out += n;
+         }
+     } while (g->z.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+     return 0;
+ }
+ 
+ static inline int gzip_write(struct gzip_stream *g, const char *data, size_t len,
+                              gzip_output_fn fn, void *ctx) {
+     g->bytes_in += len;
+     while (len > 0) {
+         /* avail_in is 32-bit */
+         uInt n = len > (1u << 30) ? (1u << 30) : (uInt)len;
+         g->z.next_in = (Bytef *)data;
+         g->z.avail_in = n;
+         if (gzip_deflate(g, Z_NO_FLUSH, fn, ctx) < 0) {
+             return -1;
+         }
+         data += n;
+         len -= n;
+     }
+     return 0;
+ }
+ 
+ static inline int gzip_finish(struct gzip_stream *g, gzip_output_fn fn, void *ctx) {
+     g->z.next_in = NULL;
+     g->z.avail_in = 0;
+     return gzip_deflate(g, Z_FINISH, fn, ctx);
+ }
+ 
+ static inline void gzip_free(struct gzip_stream *g) {
+     if (g->out) {
+         deflateEnd(&g->z);
+         free(g->out);
+         g->out = NULL;
+     }
+ }
+ 
+ #else /* built-in encoder */
+ 
+ #define GZIP_WINDOW (32 * 1024)          /* deflate's maximum distance */
+ #define GZIP_BLOCK (128 * 1024)          /* input compressed per deflate block */
+ #define GZIP_HASH_BITS 15
+ #define GZIP_MIN_MATCH 4
+ #define GZIP_MAX_MATCH 258
+ #define GZIP_STORED_MAX 65535            /* longest stored block */
+ /* Output of the largest block, all 9-bit literals, plus headers and trailer */
+ #define GZIP_OUT_ROOM ((GZIP_WINDOW + GZIP_BLOCK) / 8 * 9 + 64)
+ 
+ struct gzip_stream {
+     unsigned char *buf;      /* GZIP_WINDOW of history, then pending input */
+     size_t hist, len;        /* history bytes at the front, total bytes held */
+     int32_t *head;           /* last position (in buf) of each 4-byte hash */
+     unsigned char *out;      /* GZIP_OUT_ROOM, flushed before every block */
+     size_t out_len;
+     uint64_t bits;           /* pending output bits, LSB first */
+     unsigned int nbits;
+     uint32_t crc;
+     unsigned long long bytes_in, bytes_out;
+ };
+ 
+ /* Fixed Huffman codes (RFC 1951 3.2.6), bit-reversed for LSB-first output */
+ static uint16_t gzip_lit_code[288];
+ static uint8_t gzip_lit_bits[288];
+ static uint8_t gzip_dist_code[30];
+ static uint8_t gzip_len_sym[GZIP_MAX_MATCH + 1];  /* match length -> symbol - 257 */
+ static uint32_t gzip_crc_table[8][256];
+ static pthread_once_t gzip_tables_once = PTHREAD_ONCE_INIT;
+ 
+ static const uint16_t gzip_len_base[29] = {
+     3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+     35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+ };
+ static const uint8_t gzip_len_extra[29] = {
+     0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+     3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+ };
+ 
+ static inline const char *gzip_engine(void) {
+     return "built-in";
+ }
+ 
+ static inline unsigned int gzip_reverse(unsigned int code, unsigned int bits) {
+     unsigned int r = 0;
+ 
+     while (bits--) {
+         r = (r << 1) | (code & 1);
+         code >>= 1;
+     }
+     return r;
+ }
+ 
+ /* Fill the static tables, once per process through gzip_tables_once */
+ static inline void gzip_tables(void) {
+     for (unsigned int sym = 0; sym < 288; sym++) {
+         unsigned int code, bits;
+         if (sym < 144) {
+             code = 0x30 + sym, bits = 8;
+         } else if (sym < 256) {
+             code = 0x190 + sym - 144, bits = 9;
+         } else if (sym < 280) {
+             code = sym - 256, bits = 7;
+         } else {
+             code = 0xc0 + sym - 280, bits = 8;
+         }
+         gzip_lit_code[sym] = (uint16_t)gzip_reverse(code, bits);
+         gzip_lit_bits[sym] = (uint8_t)bits;
+     }
+     for (unsigned int d = 0; d < 30; d++) {
+         gzip_dist_code[d] = (uint8_t)gzip_reverse(d, 5);
+     }
+     for (unsigned int i = 0, len = 3; len <= GZIP_MAX_MATCH; len++) {
+         if (i < 28 && len >= gzip_len_base[i + 1]) {
+             i++;
+         }
+         gzip_len_sym[len] = (uint8_t)i;
+     }
+ 
+     /* Slicing-by-8 CRC-32 */
+     for (uint32_t n = 0; n < 256; n++) {
+         uint32_t c = n;
+         for (int k = 0; k < 8; k++) {
+             c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+         }
+         gzip_crc_table[0][n] = c;
+     }
+     for (uint32_t n = 0; n < 256; n++) {
+         for (int t = 1; t < 8; t++) {
+             uint32_t c = gzip_crc_table[t - 1][n];
+             gzip_crc_table[t][n] = gzip_crc_table[0][c & 0xff] ^ (c >> 8);
+         }
+     }
+ }
+ 
+ static inline uint32_t gzip_crc32(uint32_t crc, const unsigned char *p, size_t len) {
+     crc = ~crc;
+     while (len >= 8) {
+         uint32_t lo, hi;
+         memcpy(&lo, p, 4);
+         memcpy(&hi, p + 4, 4);
+         lo ^= crc;   /* assumes a little-endian host */
+         crc = gzip_crc_table[7][lo & 0xff] ^ gzip_crc_table[6][(lo >> 8) & 0xff] ^
+               gzip_crc_table[5][(lo >> 16) & 0xff] ^ gzip_crc_table[4][lo >> 24] ^
+               gzip_crc_table[3][hi & 0xff] ^ gzip_crc_table[2][(hi >> 8) & 0xff] ^
+               gzip_crc_table[1][(hi >> 16) & 0xff] ^ gzip_crc_table[0][hi >> 24];
+         p += 8;
+         len -= 8;
+     }
+     while (len--) {
+         crc = gzip_crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+     }
+     return ~crc;
+ }
+ 
+ static inline int gzip_flush_out(struct gzip_stream *g, gzip_output_fn fn, void *ctx) {
+     if (g->out_len > 0) {
+         if (fn(ctx, (const char *)g->out, g->out_len) < 0) {
+             return -1;
+         }
+         g->bytes_out += g->out_len;
+         g->out_len = 0;
+     }
+     return 0;
+ }
+ 
+ /* Append up to 32 bits; full 32-bit words move to the output buffer,
+  * little-endian as deflate's bit order requires */
+ static inline void gzip_put_bits(struct gzip_stream *g, uint32_t value, unsigned int n) {
+     g->bits |= (uint64_t)value << g->nbits;
+     g->nbits += n;
+     if (g->nbits >= 32) {
+         uint32_t word = (uint32_t)g->bits;
+         memcpy(g->out + g->out_len, &word, 4);
+         g->out_len += 4;
+         g->bits >>= 32;
+         g->nbits -= 32;
+     }
+ }
+ 
+ /* Pad the pending bits with zeros to a byte boundary and output them */
+ static inline void gzip_align(struct gzip_stream *g) {
+     while (g->nbits > 0) {
+         g->out[g->out_len++] = (unsigned char)g->bits;
+         g->bits >>= 8;
+         g->nbits = g->nbits > 8 ? g->nbits - 8 : 0;
+     }
+ }
+ 
+ /* Bits that n bytes take as stored blocks, nbits already pending */
+ static inline size_t gzip_stored_bits(unsigned int nbits, size_t n) {
+     size_t total = 0;
+ 
+     do {
+         size_t chunk = n < GZIP_STORED_MAX ? n : GZIP_STORED_MAX;
+         total += 3 + (8 - (nbits + 3) % 8) % 8 + 32 + 8 * chunk;
+         nbits = 0;
+         n -= chunk;
+     } while (n > 0);
+     return total;
+ }
+ 
+ /* n bytes as stored blocks: header bits, padding, LEN, NLEN, the bytes */
+ static inline void gzip_put_stored(struct gzip_stream *g, const unsigned char *data, size_t n, int last) {
+     do {
+         size_t chunk = n < GZIP_STORED_MAX ? n : GZIP_STORED_MAX;
+         uint16_t lens[2] = { (uint16_t)chunk, (uint16_t)~chunk };   /* little-endian host */
+         gzip_put_bits(g, last && chunk == n ? 1 : 0, 3);            /* BFINAL, BTYPE=00 */
+         gzip_align(g);
+         memcpy(g->out + g->out_len, lens, sizeof(lens));
+         memcpy(g->out + g->out_len + sizeof(lens), data, chunk);
+         g->out_len += sizeof(lens) + chunk;
+         data += chunk;
+         n -= chunk;
+     } while (n > 0);
+ }
+ 
+ static inline void gzip_put_match(struct gzip_stream *g, unsigned int len, unsigned int dist) {
+     unsigned int ls = gzip_len_sym[len];
+     unsigned int d = dist - 1, dc, dextra;
+ 
+     gzip_put_bits(g, gzip_lit_code[257 + ls], gzip_lit_bits[257 + ls]);
+     gzip_put_bits(g, len - gzip_len_base[ls], gzip_len_extra[ls]);
+     if (d < 4) {
+         dc = d, dextra = 0;
+     } else {
+         unsigned int l = 31 - (unsigned int)__builtin_clz(d);
+         dc = 2 * l + ((d >> (l - 1)) & 1);
+         dextra = l - 1;
+     }
+     gzip_put_bits(g, gzip_dist_code[dc], 5);
+     gzip_put_bits(g, d & ((1u << dextra) - 1), dextra);
+ }
+ 
+ static inline uint32_t gzip_hash(const unsigned char *p) {
+     uint32_t v;
+     memcpy(&v, p, 4);
+     return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+ }
+ 
+ /* Encode everything held after the history as one fixed-Huffman block.
+  * The whole block stays in the output buffer, so if it came out larger
+  * than stored blocks would be, it is taken back and stored instead. */
+ static inline int gzip_block(struct gzip_stream *g, int last, gzip_output_fn fn, void *ctx) {
+     unsigned char *buf = g->buf;
+     size_t pos = g->hist, end = g->len;
+     uint64_t start_bits = g->bits;
+     unsigned int start_nbits = g->nbits;
+ 
+     if (gzip_flush_out(g, fn, ctx) < 0) {
+         return -1;
+     }
+     gzip_put_bits(g, last ? 3 : 2, 3);   /* BFINAL, BTYPE=01 */
+     while (pos < end) {
+         size_t best = 0, dist = 0;
+ 
+         if (end - pos >= GZIP_MIN_MATCH) {
+             uint32_t h = gzip_hash(buf + pos);
+             int32_t cand = g->head[h];
+             g->head[h] = (int32_t)pos;
+             if (cand >= 0 && pos - (size_t)cand <= GZIP_WINDOW &&
+                 memcmp(buf + cand, buf + pos, GZIP_MIN_MATCH) == 0) {
+                 size_t max = end - pos < GZIP_MAX_MATCH ? end - pos : GZIP_MAX_MATCH;
+                 best = GZIP_MIN_MATCH;
+                 while (best + 8 <= max) {
+                     uint64_t a, b;
+                     memcpy(&a, buf + cand + best, 8);
+                     memcpy(&b, buf + pos + best, 8);
+                     if (a != b) {
+                         best += (size_t)__builtin_ctzll(a ^ b) / 8;
+                         goto matched;
+                     }
+                     best += 8;
+                 }
+                 while (best < max && buf[cand + best] == buf[pos + best]) {
+                     best++;
+                 }
+             matched:
+                 dist = pos - (size_t)cand;
+             }
+         }
+ 
+         if (best) {
+             gzip_put_match(g, (unsigned int)best, (unsigned int)dist);
+             /* Index the match's tail so the next repeat can find it */
+             if (pos + best + GZIP_MIN_MATCH <= end) {
+                 g->head[gzip_hash(buf + pos + best - 1)] = (int32_t)(pos + best - 1);
+             }
+             pos += best;
+         } else {
+             gzip_put_bits(g, gzip_lit_code[buf[pos]], gzip_lit_bits[buf[pos]]);
+             pos++;
+         }
+     }
+     gzip_put_bits(g, gzip_lit_code[256], gzip_lit_bits[256]);   /* end of block */
+ 
+     if (g->out_len * 8 + g->nbits - start_nbits > gzip_stored_bits(start_nbits, end - g->hist)) {
+         g->out_len = 0;
+         g->bits = start_bits;
+         g->nbits = start_nbits;
+         gzip_put_stored(g, buf + g->hist, end - g->hist, last);
+     }
+ 
+     /* Keep the last GZIP_WINDOW bytes as history for the next block */
+     if (end > GZIP_WINDOW) {
+         size_t shift = end - GZIP_WINDOW;
+         memmove(buf, buf + shift, GZIP_WINDOW);
+         for (size_t i = 0; i < (1u << GZIP_HASH_BITS); i++) {
+             g->head[i] = g->head[i] >= (int32_t)shift ? g->head[i] - (int32_t)shift : -1;
+         }
+         g->len = GZIP_WINDOW;
+     }
+     g->hist = g->len;
+     return 0;
+ }
+ 
+ static inline int gzip_init(struct gzip_stream *g, int level) {
+     static const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3 };
+ 
+     (void)level;   /* one fixed effort */
+     memset(g, 0, sizeof(*g));
+     pthread_once(&gzip_tables_once, gzip_tables);
+     g->buf = (unsigned char *)malloc(GZIP_WINDOW + GZIP_BLOCK);
+     g->head = (int32_t *)malloc(sizeof(int32_t) << GZIP_HASH_BITS);
+     g->out = (unsigned char *)malloc(GZIP_OUT_ROOM);
+     if (!g->buf || !g->head || !g->out) {
+         free(g->buf);
+         free(g->head);
+         free(g->out);
+         g->out = NULL;
+         return -1;
+     }
+     memset(g->head, 0xff, sizeof(int32_t) << GZIP_HASH_BITS);
+     memcpy(g->out, header, sizeof(header));
+     g->out_len = sizeof(header);
+     return 0;
+ }
+ 
+ static inline int gzip_write(struct gzip_stream *g, const char *data, size_t len,
+                              gzip_output_fn fn, void *ctx) {
+     g->bytes_in += len;
+     g->crc = gzip_crc32(g->crc, (const unsigned char *)data, len);
+     while (len > 0) {
+         size_t n = GZIP_WINDOW + GZIP_BLOCK - g->len;
+         if (n > len) {
+             n = len;
+         }
+         memcpy(g->buf + g->len, data, n);
+         g->len += n;
+         data += n;
+         len -= n;
+         if (g->len == GZIP_WINDOW + GZIP_BLOCK && gzip_block(g, 0, fn, ctx) < 0) {
+             return -1;
+         }
+     }
+     return 0;
+ }
+ 
+ static inline int gzip_finish(struct gzip_stream *g, gzip_output_fn fn, void *ctx) {
+     uint32_t trailer[2];
+ 
+     if (gzip_block(g, 1, fn, ctx) < 0) {
+         return -1;
+     }
+     /* Remaining bits, zero-padded to a byte boundary */
+     gzip_align(g);
+     trailer[0] = g->crc;
+     trailer[1] = (uint32_t)g->bytes_in;
+     memcpy(g->out + g->out_len, trailer, sizeof(trailer));
+     g->out_len += sizeof(trailer);
+     return gzip_flush_out(g, fn, ctx);
+ }
+ 
+ static inline void gzip_free(struct gzip_stream *g) {
+     free(g->buf);
+     free(g->head);
+     free(g->out);
+     g->buf = NULL;
+     g->head = NULL;
+     g->out = NULL;
+ }
+ 
+ #endif /* HAVE_ZLIB */
+ 
+ #endif /* QCO_GZIP_H */
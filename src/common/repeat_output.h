@@ -0,0 +1,205 @@
+/*
+ * repeat_output.h - block output engine shared by yes and no
+ *
+ * Part of QCO MoreUtils package
+ *
+ * Copyright 2025 AnmiTaliDev
+ * Licensed under the Apache License, Version 2.0
+ *
+ * A repeated line is replicated into a page-aligned block holding a whole
+ * number of copies, and the block is pushed to the output descriptor with
+ * the cheapest method it supports. Usable from both C and C++.
+ */
+
+ #ifndef QCO_REPEAT_OUTPUT_H
+ #define QCO_REPEAT_OUTPUT_H
+ 
+ #ifndef _GNU_SOURCE
+ #define _GNU_SOURCE
+ #endif
+ #include <stdlib.h>
+ #include <string.h>
+ #include <unistd.h>
+ #include <errno.h>
+ #include <fcntl.h>
+ #include <sys/stat.h>
+ #include <sys/uio.h>
+ 
+ #define OUTPUT_BLOCK_SIZE (64 * 1024)  // 16 pages, the default pipe capacity on Linux
+ 
+ // How a block reaches the output descriptor
+ enum output_method {
+     OUTPUT_WRITE,     // plain write(2): ttys, files, devices, and anything splice refuses
+     OUTPUT_VMSPLICE,  // stdout is a pipe: map the block's pages straight into it
+     OUTPUT_SPLICE     // socket: vmsplice into an internal relay pipe, then splice onward
+ };
+ 
+ struct output {
+     int fd;
+     enum output_method method;
+     int relay[2];
+     size_t relay_size;
+ };
+ 
+ static inline const char* output_method_name(enum output_method method) {
+     static const char* const names[] = { "write", "vmsplice", "splice" };
+     return names[method];
+ }
+ 
+ // Write the whole range, retrying on short writes and EINTR
+ static inline int write_all(int fd, const char* data, size_t len) {
+     while (len > 0) {
+         ssize_t written = write(fd, data, len);
+         if (written < 0) {
+             if (errno == EINTR) {
+                 continue;
+             }
+             return -1;
+         }
+         data += written;
+         len -= (size_t)written;
+     }
+     return 0;
+ }
+ 
+ // Hand the range to a pipe by reference. The block is never modified after
+ // it has been filled, so the pipe may keep pointing at its pages.
+ static inline ssize_t vmsplice_some(int pipe_fd, const char* data, size_t len) {
+     struct iovec iov;
+     ssize_t moved;
+ 
+     iov.iov_base = (void*)data;
+     iov.iov_len = len;
+     do {
+         moved = vmsplice(pipe_fd, &iov, 1, 0);
+     } while (moved < 0 && errno == EINTR);
+     return moved;
+ }
+ 
+ // Pick the cheapest transfer method the output descriptor supports
+ static inline void setup_output(struct output* out, int fd) {
+     struct stat st;
+ 
+     out->fd = fd;
+     out->method = OUTPUT_WRITE;
+     out->relay[0] = out->relay[1] = -1;
+     out->relay_size = 0;
+ 
+     if (fstat(fd, &st) < 0 || isatty(fd)) {
+         return;
+     }
+ 
+     if (S_ISFIFO(st.st_mode)) {
+         // Best effort: a pipe as large as the block takes it in one call
+         fcntl(fd, F_SETPIPE_SZ, OUTPUT_BLOCK_SIZE);
+         out->method = OUTPUT_VMSPLICE;
+         return;
+     }
+ 
+     // Regular files gain nothing from the relay (the page cache copy
+     // happens either way) and /dev/null is far cheaper to write(2) to, so
+     // only sockets take the chained path
+     if (S_ISSOCK(st.st_mode) && pipe(out->relay) == 0) {
+         int size;
+         fcntl(out->relay[1], F_SETPIPE_SZ, OUTPUT_BLOCK_SIZE);
+         size = fcntl(out->relay[1], F_GETPIPE_SZ);
+         out->relay_size = size > 0 ? (size_t)size : 4096;
+         out->method = OUTPUT_SPLICE;
+     }
+ }
+ 
+ static inline void close_output(struct output* out) {
+     if (out->relay[0] != -1) {
+         close(out->relay[0]);
+         close(out->relay[1]);
+         out->relay[0] = out->relay[1] = -1;
+     }
+ }
+ 
+ // Emit the whole range with the output's method. When the kernel turns a
+ // zero-copy path down (EINVAL, e.g. O_APPEND files or odd devices), drop
+ // to write(2) for the rest of the run without losing or repeating bytes.
+ static inline int emit(struct output* out, const char* data, size_t len) {
+     while (len > 0) {
+         if (out->method == OUTPUT_VMSPLICE) {
+             ssize_t moved = vmsplice_some(out->fd, data, len);
+             if (moved < 0) {
+                 if (errno == EINVAL || errno == ENOSYS) {
+                     out->method = OUTPUT_WRITE;
+                     continue;
+                 }
+                 return -1;
+             }
+             data += moved;
+             len -= (size_t)moved;
+         } else if (out->method == OUTPUT_SPLICE) {
+             size_t chunk = len < out->relay_size ? len : out->relay_size;
+             ssize_t pending = vmsplice_some(out->relay[1], data, chunk);
+             if (pending < 0) {
+                 close_output(out);
+                 out->method = OUTPUT_WRITE;
+                 continue;
+             }
+             while (pending > 0) {
+                 ssize_t sent = splice(out->relay[0], NULL, out->fd, NULL, (size_t)pending, SPLICE_F_MOVE);
+                 if (sent < 0) {
+                     if (errno == EINTR) {
+                         continue;
+                     }
+                     if (errno == EINVAL || errno == ENOSYS) {
+                         // The relay still holds these bytes; write them from
+                         // the block instead and discard the relay
+                         if (write_all(out->fd, data, (size_t)pending) < 0) {
+                             return -1;
+                         }
+                         close_output(out);
+                         out->method = OUTPUT_WRITE;
+                         sent = pending;
+                     } else {
+                         return -1;
+                     }
+                 }
+                 data += sent;
+                 len -= (size_t)sent;
+                 pending -= sent;
+             }
+         } else {
+             return write_all(out->fd, data, len);
+         }
+     }
+     return 0;
+ }
+ 
+ 
+ // Allocate a page-aligned block for as many whole copies of a line of
+ // line_len bytes as fit in OUTPUT_BLOCK_SIZE, so every write ends on a
+ // line boundary. A longer line gets a block of exactly one copy.
+ static inline char* alloc_block(size_t line_len, size_t* copies) {
+     long page_size = sysconf(_SC_PAGESIZE);
+     void* block = NULL;
+     size_t count = OUTPUT_BLOCK_SIZE / line_len;
+ 
+     if (count == 0) {
+         count = 1;
+     }
+     if (posix_memalign(&block, page_size > 0 ? (size_t)page_size : 4096, count * line_len) != 0) {
+         return NULL;
+     }
+     *copies = count;
+     return (char*)block;
+ }
+ 
+ // Replicate the line at the start of the block into the remaining copies,
+ // doubling the filled prefix instead of one memcpy per line
+ static inline void replicate_block(char* block, size_t line_len, size_t copies) {
+     size_t total = line_len * copies;
+     size_t filled = line_len;
+ 
+     while (filled < total) {
+         size_t chunk = filled < total - filled ? filled : total - filled;
+         memcpy(block + filled, block, chunk);
+         filled += chunk;
+     }
+ }
+ 
+ #endif /* QCO_REPEAT_OUTPUT_H */
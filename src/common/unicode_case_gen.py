@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+#
+# unicode_case_gen.py - regenerate the case mapping data in unicode_case.h
+# Copyright 2025 AnmiTaliDev
+# Licensed under the Apache License, Version 2.0
+#
+# Takes the mappings from the unicodedata module of the running Python and
+# rewrites the block between the GENERATED markers of unicode_case.h. A code
+# point that maps to one code point becomes part of a range with a common
+# delta; one that maps to several (German sharp s to SS) becomes a special.
+# Title case, case folding and swapcase come from str.title(),
+# str.casefold() and str.swapcase() of a single character. The code points
+# with the Cased property (which title case goes by) are listed as intervals.
+#
+
+import os
+import sys
+import unicodedata
+
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "unicode_case.h")
+BEGIN = " /* BEGIN GENERATED"
+END = " /* END GENERATED */"
+
+MODES = [
+    ("upper", str.upper),
+    ("lower", str.lower),
+    ("title", str.title),
+    ("fold", str.casefold),
+    ("swap", str.swapcase),
+]
+
+
+def mappings(func):
+    for cp in range(0x110000):
+        if 0xD800 <= cp <= 0xDFFF:
+            continue
+        mapped = func(chr(cp))
+        if mapped != chr(cp):
+            yield cp, [ord(c) for c in mapped]
+
+
+def ranges(simple):
+    runs = []
+    for cp, to in simple:
+        delta = to - cp
+        if runs:
+            first, last, d, stride = runs[-1]
+            if d == delta and cp - last == stride:
+                runs[-1][1] = cp
+                continue
+            if d == delta and first == last and cp - last == 2:
+                runs[-1][1:] = [cp, d, 2]
+                continue
+        runs.append([cp, cp, delta, 1])
+    return runs
+
+
+def emit_cased(out):
+    runs = []
+    for cp in range(0x110000):
+        if 0xD800 <= cp <= 0xDFFF:
+            continue
+        c = chr(cp)
+        if not (c.islower() or c.isupper() or c.istitle()):
+            continue
+        if runs and runs[-1][1] == cp - 1:
+            runs[-1][1] = cp
+        else:
+            runs.append([cp, cp])
+
+    out.append(" static constexpr ucase_interval ucase_cased_intervals[] = {")
+    for first, last in runs:
+        out.append("     {0x%04X, 0x%04X}," % (first, last))
+    out.append(" };")
+    out.append(" ")
+
+
+def emit(name, func, out, limits):
+    simple, special = [], []
+    for cp, to in mappings(func):
+        if len(to) == 1:
+            simple.append((cp, to[0]))
+        else:
+            special.append((cp, to))
+        size = len("".join(map(chr, to)).encode())
+        limits[0] = max(limits[0], size)
+        limits[1] = max(limits[1], -(-size // len(chr(cp).encode())))
+
+    out.append(" static constexpr ucase_range ucase_%s_ranges[] = {" % name)
+    for first, last, delta, stride in ranges(simple):
+        out.append("     {0x%04X, 0x%04X, %d, %d}," % (first, last, delta, stride))
+    out.append(" };")
+    out.append(" ")
+    out.append(" static constexpr ucase_special ucase_%s_specials[] = {" % name)
+    for cp, to in special:
+        assert len(to) <= 3
+        to = to + [0] * (3 - len(to))
+        out.append("     {0x%04X, {%s}}," % (cp, ", ".join("0x%04X" % c for c in to)))
+    out.append(" };")
+    out.append(" ")
+
+
+def main():
+    with open(HEADER) as f:
+        text = f.read()
+    start = text.index(BEGIN)
+    start = text.index("\n", start) + 1
+    stop = text.index(END)
+
+    out, limits = [], [0, 0]
+    for name, func in MODES:
+        emit(name, func, out, limits)
+    emit_cased(out)
+    out.append(" /* Longest UTF-8 form of a mapping, and the most a mapping grows its input */")
+    out.append(" #define UCASE_MAX_BYTES %d" % limits[0])
+    out.append(" #define UCASE_MAX_GROWTH %d" % limits[1])
+
+    text = text[:start] + "\n".join(out) + "\n" + text[stop:]
+    text = text.replace(text[text.index(BEGIN):text.index("\n", text.index(BEGIN))],
+                        BEGIN + " by unicode_case_gen.py from Unicode %s */" % unicodedata.unidata_version)
+    with open(HEADER, "w") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
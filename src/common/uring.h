@@ -0,0 +1,180 @@
+/*
+ * uring.h - minimal io_uring ring over the raw system calls
+ *
+ * Part of QCO MoreUtils package
+ *
+ * Copyright 2025 AnmiTaliDev
+ * Licensed under the Apache License, Version 2.0
+ *
+ * Just enough of the io_uring interface to queue SQEs, submit them in
+ * one io_uring_enter(2), and reap CQEs, without depending on liburing
+ * being installed. All calls return -1 with errno set on failure, so a
+ * caller can fall back to plain read(2)/write(2).
+ */
+
+ #ifndef QCO_URING_H
+ #define QCO_URING_H
+ 
+ #include <stdlib.h>
+ #include <string.h>
+ #include <unistd.h>
+ #include <errno.h>
+ #include <sys/mman.h>
+ #include <sys/syscall.h>
+ #include <linux/io_uring.h>
+ 
+ struct uring {
+     int fd;
+     unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+     unsigned int *cq_head, *cq_tail, *cq_mask;
+     struct io_uring_sqe *sqes;
+     struct io_uring_cqe *cqes;
+     void *sq_ptr, *cq_ptr;
+     size_t sq_len, cq_len, sqes_len;
+     unsigned int sq_entries;
+     unsigned int queued;   /* SQEs prepared but not yet submitted */
+ };
+ 
+ static inline int uring_init(struct uring *r, unsigned int entries) {
+     struct io_uring_params p;
+ 
+     memset(r, 0, sizeof(*r));
+     memset(&p, 0, sizeof(p));
+     r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+     if (r->fd < 0) {
+         return -1;
+     }
+ 
+     r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+     r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+     if (p.features & IORING_FEAT_SINGLE_MMAP) {
+         if (r->cq_len > r->sq_len) {
+             r->sq_len = r->cq_len;
+         }
+         r->cq_len = r->sq_len;
+     }
+ 
+     r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      r->fd, IORING_OFF_SQ_RING);
+     if (r->sq_ptr == MAP_FAILED) {
+         goto fail;
+     }
+     if (p.features & IORING_FEAT_SINGLE_MMAP) {
+         r->cq_ptr = r->sq_ptr;
+     } else {
+         r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          r->fd, IORING_OFF_CQ_RING);
+         if (r->cq_ptr == MAP_FAILED) {
+             goto fail;
+         }
+     }
+     r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+     r->sqes = (struct io_uring_sqe *)mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+     if (r->sqes == MAP_FAILED) {
+         goto fail;
+     }
+ 
+     r->sq_head = (unsigned int *)((char *)r->sq_ptr + p.sq_off.head);
+     r->sq_tail = (unsigned int *)((char *)r->sq_ptr + p.sq_off.tail);
+     r->sq_mask = (unsigned int *)((char *)r->sq_ptr + p.sq_off.ring_mask);
+     r->sq_array = (unsigned int *)((char *)r->sq_ptr + p.sq_off.array);
+     r->cq_head = (unsigned int *)((char *)r->cq_ptr + p.cq_off.head);
+     r->cq_tail = (unsigned int *)((char *)r->cq_ptr + p.cq_off.tail);
+     r->cq_mask = (unsigned int *)((char *)r->cq_ptr + p.cq_off.ring_mask);
+     r->cqes = (struct io_uring_cqe *)((char *)r->cq_ptr + p.cq_off.cqes);
+     r->sq_entries = p.sq_entries;
+     return 0;
+ 
+ fail:
+     {
+         int saved = errno;
+         if (r->sq_ptr && r->sq_ptr != MAP_FAILED) {
+             munmap(r->sq_ptr, r->sq_len);
+         }
+         if (r->cq_ptr && r->cq_ptr != MAP_FAILED && r->cq_ptr != r->sq_ptr) {
+             munmap(r->cq_ptr, r->cq_len);
+         }
+         close(r->fd);
+         errno = saved;
+     }
+     return -1;
+ }
+ 
+ static inline void uring_exit(struct uring *r) {
+     munmap(r->sqes, r->sqes_len);
+     if (r->cq_ptr != r->sq_ptr) {
+         munmap(r->cq_ptr, r->cq_len);
+     }
+     munmap(r->sq_ptr, r->sq_len);
+     close(r->fd);
+ }
+ 
+ static inline int uring_register(struct uring *r, unsigned int opcode, const void *arg, unsigned int nr) {
+     return (int)syscall(__NR_io_uring_register, r->fd, opcode, arg, nr);
+ }
+ 
+ /* 0 if the kernel implements every opcode in ops. A ring can be set up
+  * on kernels that lack some (IORING_OP_READ and _WRITE came in 5.6), and
+  * their SQEs would only fail one by one with -EINVAL. */
+ static inline int uring_probe(struct uring *r, const unsigned char *ops, size_t n) {
+     struct io_uring_probe *probe = calloc(1, sizeof(*probe) + 256 * sizeof(struct io_uring_probe_op));
+     int supported = probe && uring_register(r, IORING_REGISTER_PROBE, probe, 256) == 0;
+ 
+     for (size_t i = 0; supported && i < n; i++) {
+         supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+         if (!supported) {
+             errno = EOPNOTSUPP;
+         }
+     }
+     free(probe);
+     return supported ? 0 : -1;
+ }
+ 
+ /* Next free SQE, zeroed; NULL when the submission queue is full */
+ static inline struct io_uring_sqe *uring_get_sqe(struct uring *r) {
+     unsigned int head = __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE);
+     unsigned int tail = *r->sq_tail + r->queued;
+     struct io_uring_sqe *sqe;
+ 
+     if (tail - head >= r->sq_entries) {
+         return NULL;
+     }
+     sqe = &r->sqes[tail & *r->sq_mask];
+     memset(sqe, 0, sizeof(*sqe));
+     r->sq_array[tail & *r->sq_mask] = tail & *r->sq_mask;
+     r->queued++;
+     return sqe;
+ }
+ 
+ /* Submit everything queued and wait until at least wait_nr CQEs are ready.
+  * A signal during a wait with nothing left to submit fails it with EINTR,
+  * so the caller can look at why it was woken before waiting again. */
+ static inline int uring_enter(struct uring *r, unsigned int wait_nr) {
+     unsigned int submit = r->queued;
+     int ret;
+ 
+     __atomic_store_n(r->sq_tail, *r->sq_tail + submit, __ATOMIC_RELEASE);
+     r->queued = 0;
+     do {
+         ret = (int)syscall(__NR_io_uring_enter, r->fd, submit, wait_nr,
+                            wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+     } while (ret < 0 && errno == EINTR && submit > 0);
+     return ret < 0 ? -1 : 0;
+ }
+ 
+ /* Oldest unread CQE, or NULL when the completion queue is empty */
+ static inline struct io_uring_cqe *uring_peek_cqe(struct uring *r) {
+     unsigned int head = *r->cq_head;
+ 
+     if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+         return NULL;
+     }
+     return &r->cqes[head & *r->cq_mask];
+ }
+ 
+ static inline void uring_cqe_seen(struct uring *r) {
+     __atomic_store_n(r->cq_head, *r->cq_head + 1, __ATOMIC_RELEASE);
+ }
+ 
+ #endif /* QCO_URING_H */
@@ -21,9 +21,263 @@
 #include <iomanip>
 #include <algorithm>
 #include <regex>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
 #include <getopt.h>
 #include <unistd.h>
 
+// A parsed JSON value. Objects and arrays keep their children in document
+// order, an object member's name in key; numbers keep their source text
+// so nothing is lost to rounding.
+struct JsonValue {
+    enum Type { Null, Boolean, Number, String, Array, Object };
+    
+    Type type = Null;
+    std::string key;
+    std::string text;       // string contents, number literal, true/false/null
+    std::vector<JsonValue> items;
+};
+
+// Single-pass recursive descent parser for the full JSON grammar (RFC 8259).
+// Errors throw std::runtime_error naming the line and column.
+class JsonParser {
+private:
+    static const int MAX_DEPTH = 512;
+    
+    const char* begin;
+    const char* p;
+    const char* end;
+    
+    [[noreturn]] void fail(const std::string& what) const {
+        size_t line = 1 + std::count(begin, p, '\n');
+        const char* line_start = p;
+        while (line_start > begin && line_start[-1] != '\n') line_start--;
+        throw std::runtime_error("line " + std::to_string(line) + ", column " +
+                                 std::to_string(p - line_start + 1) + ": " + what);
+    }
+    
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+    }
+    
+    void expect(char c) {
+        skipSpace();
+        if (p == end || *p != c) fail(std::string("expected '") + c + "'");
+        p++;
+        skipSpace();
+    }
+    
+    void parseLiteral(JsonValue& value, const char* word, JsonValue::Type type) {
+        size_t len = std::strlen(word);
+        if (static_cast<size_t>(end - p) < len || std::memcmp(p, word, len) != 0) fail("invalid literal");
+        value.type = type;
+        value.text.assign(word, len);
+        p += len;
+    }
+    
+    unsigned hex4() {
+        unsigned code = 0;
+        if (end - p < 4) fail("truncated \\u escape");
+        for (int i = 0; i < 4; i++, p++) {
+            char c = *p;
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else fail("invalid \\u escape");
+        }
+        return code;
+    }
+    
+    static void appendUtf8(std::string& out, unsigned cp) {
+        if (cp < 0x80) {
+            out += static_cast<char>(cp);
+        } else if (cp < 0x800) {
+            out += static_cast<char>(0xC0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            out += static_cast<char>(0xE0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+    
+    // Parse the string at p (on its opening quote) into out, which is
+    // appended to in runs between escapes
+    void parseString(std::string& out) {
+        p++;
+        for (;;) {
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) >= 0x20) p++;
+            out.append(run, p - run);
+            
+            if (p == end) fail("unterminated string");
+            if (*p == '"') {
+                p++;
+                return;
+            }
+            if (*p != '\\') fail("control character in string");
+            
+            if (++p == end) fail("unterminated string");
+            switch (*p++) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned cp = hex4();
+                    if (cp >= 0xDC00 && cp <= 0xDFFF) fail("unpaired surrogate in \\u escape");
+                    if (cp >= 0xD800 && cp <= 0xDBFF) {
+                        if (end - p < 2 || p[0] != '\\' || p[1] != 'u') fail("unpaired surrogate in \\u escape");
+                        p += 2;
+                        unsigned low = hex4();
+                        if (low < 0xDC00 || low > 0xDFFF) fail("unpaired surrogate in \\u escape");
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    p--;
+                    fail("invalid escape sequence");
+            }
+        }
+    }
+    
+    void parseNumber(JsonValue& value) {
+        const char* stop = scanNumber(p, end);
+        if (!stop) fail("invalid number");
+        value.type = JsonValue::Number;
+        value.text.assign(p, stop);
+        p = stop;
+    }
+    
+    void parseValue(JsonValue& value, int depth) {
+        if (p == end) fail("unexpected end of input");
+        switch (*p) {
+            case '{': parseObject(value, depth); break;
+            case '[': parseArray(value, depth); break;
+            case '"':
+                value.type = JsonValue::String;
+                parseString(value.text);
+                break;
+            case 't': parseLiteral(value, "true", JsonValue::Boolean); break;
+            case 'f': parseLiteral(value, "false", JsonValue::Boolean); break;
+            case 'n': parseLiteral(value, "null", JsonValue::Null); break;
+            case '-':
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9':
+                parseNumber(value);
+                break;
+            default: fail("expected a value");
+        }
+    }
+    
+    void parseObject(JsonValue& value, int depth) {
+        if (depth >= MAX_DEPTH) fail("nesting too deep");
+        value.type = JsonValue::Object;
+        expect('{');
+        if (p < end && *p == '}') {
+            p++;
+            return;
+        }
+        
+        for (;;) {
+            if (p == end || *p != '"') fail("expected a member name");
+            value.items.emplace_back();
+            JsonValue& member = value.items.back();
+            parseString(member.key);
+            expect(':');
+            parseValue(member, depth + 1);
+            skipSpace();
+            if (p < end && *p == ',') {
+                expect(',');
+                continue;
+            }
+            if (p < end && *p == '}') {
+                p++;
+                return;
+            }
+            fail("expected ',' or '}'");
+        }
+    }
+    
+    void parseArray(JsonValue& value, int depth) {
+        if (depth >= MAX_DEPTH) fail("nesting too deep");
+        value.type = JsonValue::Array;
+        expect('[');
+        if (p < end && *p == ']') {
+            p++;
+            return;
+        }
+        
+        for (;;) {
+            value.items.emplace_back();
+            parseValue(value.items.back(), depth + 1);
+            skipSpace();
+            if (p < end && *p == ',') {
+                expect(',');
+                continue;
+            }
+            if (p < end && *p == ']') {
+                p++;
+                return;
+            }
+            fail("expected ',' or ']'");
+        }
+    }
+    
+public:
+    explicit JsonParser(const std::string& text)
+        : begin(text.data()), p(text.data()), end(text.data() + text.size()) {}
+    
+    // End of the JSON number starting at s, or nullptr if there is none:
+    // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    static const char* scanNumber(const char* s, const char* end) {
+        auto digits = [&s, end]() {
+            const char* start = s;
+            while (s < end && *s >= '0' && *s <= '9') s++;
+            return s > start;
+        };
+        
+        if (s < end && *s == '-') s++;
+        if (s < end && *s == '0') {
+            s++;
+        } else if (!digits()) {
+            return nullptr;
+        }
+        if (s < end && *s == '.') {
+            s++;
+            if (!digits()) return nullptr;
+        }
+        if (s < end && (*s == 'e' || *s == 'E')) {
+            s++;
+            if (s < end && (*s == '+' || *s == '-')) s++;
+            if (!digits()) return nullptr;
+        }
+        return s;
+    }
+    
+    JsonValue parse() {
+        JsonValue root;
+        skipSpace();
+        parseValue(root, 0);
+        skipSpace();
+        if (p != end) fail("unexpected data after the document");
+        return root;
+    }
+};
+
 // Simple key-value configuration storage
 class ConfigConverter {
 private:
@@ -43,8 +297,13 @@ private:
     bool minify = false;
     
     std::map<std::string, std::string> config_data;
+    std::map<std::string, JsonValue::Type> value_types;    // keys that came from JSON
     std::vector<std::string> comments;
     
+    // JSON input is kept as a tree until it has to be flattened
+    JsonValue json_root;
+    bool have_tree = false;
+    
 public:
     void setInputFormat(const std::string& format) { input_format = format; }
     void setOutputFormat(const std::string& format) { output_format = format; }
@@ -95,40 +354,52 @@ public:
         return "json"; // Default fallback
     }
     
+    // Move the leaves of a JSON tree into config_data under dotted paths,
+    // as parseINI does for sections: {"db": {"hosts": ["a"]}} gives
+    // db.hosts.0 = a. An empty object or array is kept as {} or [].
+    // path is extended in place for the children.
+    void flattenJSON(JsonValue& value, std::string& path) {
+        bool container = value.type == JsonValue::Object || value.type == JsonValue::Array;
+        
+        if (!container || value.items.empty()) {
+            if (!path.empty()) {
+                config_data[path] = container ? (value.type == JsonValue::Object ? "{}" : "[]")
+                                              : std::move(value.text);
+                value_types[path] = value.type;
+            }
+            return;
+        }
+        
+        size_t len = path.size();
+        for (size_t i = 0; i < value.items.size(); i++) {
+            if (len > 0) path += '.';
+            path += value.type == JsonValue::Object ? value.items[i].key : std::to_string(i);
+            flattenJSON(value.items[i], path);
+            path.resize(len);
+        }
+    }
+    
+    // The tree itself is only flattened for output formats without nesting
+    void flattenTree() {
+        if (have_tree) {
+            std::string path;
+            flattenJSON(json_root, path);
+            json_root = JsonValue();
+            have_tree = false;
+        }
+    }
+    
     bool parseJSON(const std::string& content) {
         try {
-            // Simple JSON parser (basic implementation)
-            std::regex json_pattern("\"([^\"]+)\"\\s*:\\s*\"([^\"]*)\"");
-            std::regex number_pattern("\"([^\"]+)\"\\s*:\\s*(\\d+(?:\\.\\d+)?)");
-            std::regex bool_pattern("\"([^\"]+)\"\\s*:\\s*(true|false)");
-            
-            std::sregex_iterator iter(content.begin(), content.end(), json_pattern);
-            std::sregex_iterator end;
-            
-            for (; iter != end; ++iter) {
-                std::string key = (*iter)[1].str();
-                std::string value = (*iter)[2].str();
-                config_data[key] = value;
-            }
-            
-            // Parse numbers
-            std::sregex_iterator num_iter(content.begin(), content.end(), number_pattern);
-            for (; num_iter != end; ++num_iter) {
-                std::string key = (*num_iter)[1].str();
-                std::string value = (*num_iter)[2].str();
-                config_data[key] = value;
-            }
-            
-            // Parse booleans
-            std::sregex_iterator bool_iter(content.begin(), content.end(), bool_pattern);
-            for (; bool_iter != end; ++bool_iter) {
-                std::string key = (*bool_iter)[1].str();
-                std::string value = (*bool_iter)[2].str();
-                config_data[key] = value;
+            JsonParser parser(content);
+            json_root = parser.parse();
+            if (json_root.type != JsonValue::Object && json_root.type != JsonValue::Array) {
+                throw std::runtime_error("the top-level value must be an object or an array");
             }
-            
+            have_tree = true;
             return true;
-        } catch (...) {
+        } catch (const std::exception& e) {
+            std::cerr << "conf-convert: json: " << e.what() << "\n";
             return false;
         }
     }
@@ -267,22 +538,210 @@ public:
                 case '\n': result += "\\n"; break;
                 case '\r': result += "\\r"; break;
                 case '\t': result += "\\t"; break;
-                default: result += c; break;
+                case '\b': result += "\\b"; break;
+                case '\f': result += "\\f"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        char escape[8];
+                        std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                        result += escape;
+                    } else {
+                        result += c;
+                    }
+                    break;
             }
         }
         return result;
     }
     
     bool isNumber(const std::string& str) {
-        if (str.empty()) return false;
-        std::regex number_pattern("^-?\\d+(?:\\.\\d+)?$");
-        return std::regex_match(str, number_pattern);
+        const char* end = str.data() + str.size();
+        return JsonParser::scanNumber(str.data(), end) == end && !str.empty();
     }
     
     bool isBoolean(const std::string& str) {
         return str == "true" || str == "false";
     }
     
+    // Write a value as JSON: as parsed if it came from JSON, otherwise
+    // unquoted only if it looks like a number or a boolean
+    void writeJsonScalar(std::ostringstream& output, const std::string& key, const std::string& value) {
+        auto type = value_types.find(key);
+        bool bare = type != value_types.end() ? type->second != JsonValue::String
+                                              : isNumber(value) || isBoolean(value);
+        if (bare) {
+            output << value;
+        } else {
+            output << "\"" << escapeJsonString(value) << "\"";
+        }
+    }
+    
+    static bool listed(const std::vector<std::string>& keys, const std::string& key) {
+        return std::find(keys.begin(), keys.end(), key) != keys.end();
+    }
+    
+    // --include/--exclude on the tree, by dotted path: a member goes if it
+    // is excluded, or if there are includes and it is neither included,
+    // inside an included member, nor on the way to one
+    void filterTree(JsonValue& value, std::string& path, bool included) {
+        size_t len = path.size();
+        size_t kept = 0;
+        
+        for (size_t i = 0; i < value.items.size(); i++) {
+            JsonValue& item = value.items[i];
+            bool container = item.type == JsonValue::Object || item.type == JsonValue::Array;
+            
+            if (len > 0) path += '.';
+            path += value.type == JsonValue::Object ? item.key : std::to_string(i);
+            bool inside = included || listed(include_keys, path);
+            bool keep = !listed(exclude_keys, path);
+            if (keep && !inside) {
+                keep = container && std::any_of(include_keys.begin(), include_keys.end(),
+                                                [&path](const std::string& key) {
+                                                    return key.size() > path.size() && key[path.size()] == '.' &&
+                                                           key.compare(0, path.size(), path) == 0;
+                                                });
+            }
+            if (keep && container) {
+                filterTree(item, path, inside);
+                keep = inside || !item.items.empty();
+            }
+            if (keep) {
+                if (kept != i) value.items[kept] = std::move(item);
+                kept++;
+            }
+            path.resize(len);
+        }
+        value.items.resize(kept);
+    }
+    
+    static void sortTree(JsonValue& value) {
+        if (value.type == JsonValue::Object) {
+            std::stable_sort(value.items.begin(), value.items.end(),
+                             [](const JsonValue& a, const JsonValue& b) { return a.key < b.key; });
+        }
+        for (auto& item : value.items) {
+            sortTree(item);
+        }
+    }
+    
+    // JSON from the tree, nested as it was read; pretty-printed like
+    // generateJSON unless minified
+    void writeJsonTree(std::string& out, const JsonValue& value, int depth) {
+        if (value.type == JsonValue::String) {
+            out += '"';
+            out += escapeJsonString(value.text);
+            out += '"';
+            return;
+        }
+        if (value.type != JsonValue::Object && value.type != JsonValue::Array) {
+            out += value.text;
+            return;
+        }
+        
+        bool object = value.type == JsonValue::Object;
+        out += object ? '{' : '[';
+        for (size_t i = 0; i < value.items.size(); i++) {
+            if (i > 0) out += ',';
+            if (!minify) {
+                out += '\n';
+                out.append(static_cast<size_t>(indent_size) * (depth + 1), ' ');
+            }
+            if (object) {
+                out += '"';
+                out += escapeJsonString(value.items[i].key);
+                out += minify ? "\":" : "\": ";
+            }
+            writeJsonTree(out, value.items[i], depth + 1);
+        }
+        if (!minify && !value.items.empty()) {
+            out += '\n';
+            out.append(static_cast<size_t>(indent_size) * depth, ' ');
+        }
+        out += object ? '}' : ']';
+    }
+    
+    // A string as a YAML scalar: plain when it cannot be read as anything
+    // else, double-quoted otherwise. Quoting uses the JSON escapes plus
+    // \u ones for what YAML does not allow raw: DEL, C1 controls, the line
+    // and paragraph separators and the byte order mark.
+    std::string yamlString(const std::string& str) {
+        static const char* const reserved[] = {"null", "~", "true", "false", "yes", "no", "on", "off", "y", "n"};
+        std::string lower = str;
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        
+        std::string escaped = escapeJsonString(str);
+        std::string quoted = "\"";
+        bool special = false;
+        for (size_t i = 0; i < escaped.size(); i++) {
+            const unsigned char* c = reinterpret_cast<const unsigned char*>(escaped.data()) + i;
+            size_t left = escaped.size() - i;
+            unsigned cp = 0;
+            size_t len = 0;
+            if (c[0] == 0x7F) {
+                cp = 0x7F;
+                len = 1;
+            } else if (left >= 2 && c[0] == 0xC2 && c[1] >= 0x80 && c[1] <= 0x9F) {
+                cp = c[1];
+                len = 2;
+            } else if (left >= 3 && c[0] == 0xE2 && c[1] == 0x80 && (c[2] == 0xA8 || c[2] == 0xA9)) {
+                cp = c[2] == 0xA8 ? 0x2028 : 0x2029;
+                len = 3;
+            } else if (left >= 3 && c[0] == 0xEF && c[1] == 0xBB && c[2] == 0xBF) {
+                cp = 0xFEFF;
+                len = 3;
+            }
+            if (len == 0) {
+                quoted += escaped[i];
+                continue;
+            }
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", cp);
+            quoted += escape;
+            i += len - 1;
+            special = true;
+        }
+        quoted += '"';
+        
+        bool quote = special || str.empty() || std::strchr("-?:,[]{}#&*!|>'\"%@` \t0123456789+.", str[0]) ||
+                     str.back() == ' ' || str.back() == '\t' || str.back() == ':' ||
+                     str.find(": ") != std::string::npos || str.find(":\t") != std::string::npos ||
+                     str.find(" #") != std::string::npos || str.find("\t#") != std::string::npos ||
+                     escaped.size() != str.size() ||
+                     std::find(std::begin(reserved), std::end(reserved), lower) != std::end(reserved);
+        return quote ? quoted : str;
+    }
+    
+    // YAML from the tree: block mappings and sequences indented by
+    // indent_size, empty ones and scalars inline. The caller has written
+    // the "key:" or "-" the value belongs to, if any.
+    void writeYamlTree(std::string& out, const JsonValue& value, int depth) {
+        bool container = value.type == JsonValue::Object || value.type == JsonValue::Array;
+        
+        if (!container || value.items.empty()) {
+            if (depth > 0) out += ' ';
+            if (container) {
+                out += value.type == JsonValue::Object ? "{}" : "[]";
+            } else {
+                out += value.type == JsonValue::String ? yamlString(value.text) : value.text;
+            }
+            out += '\n';
+            return;
+        }
+        
+        if (depth > 0) out += '\n';
+        for (const auto& item : value.items) {
+            out.append(static_cast<size_t>(indent_size) * depth, ' ');
+            if (value.type == JsonValue::Object) {
+                out += yamlString(item.key);
+                out += ':';
+            } else {
+                out += '-';
+            }
+            writeYamlTree(out, item, depth + 1);
+        }
+    }
+    
     std::string generateJSON() {
         std::ostringstream output;
         
@@ -292,14 +751,7 @@ public:
             for (const auto& pair : config_data) {
                 if (!first) output << ",";
                 output << "\"" << escapeJsonString(pair.first) << "\":";
-                
-                if (isNumber(pair.second)) {
-                    output << pair.second;
-                } else if (isBoolean(pair.second)) {
-                    output << pair.second;
-                } else {
-                    output << "\"" << escapeJsonString(pair.second) << "\"";
-                }
+                writeJsonScalar(output, pair.first, pair.second);
                 
                 first = false;
             }
@@ -312,14 +764,7 @@ public:
             for (const auto& pair : config_data) {
                 if (!first) output << ",\n";
                 output << indent << "\"" << escapeJsonString(pair.first) << "\": ";
-                
-                if (isNumber(pair.second)) {
-                    output << pair.second;
-                } else if (isBoolean(pair.second)) {
-                    output << pair.second;
-                } else {
-                    output << "\"" << escapeJsonString(pair.second) << "\"";
-                }
+                writeJsonScalar(output, pair.first, pair.second);
                 
                 first = false;
             }
@@ -454,6 +899,7 @@ public:
     
     void printStatistics() {
         if (!show_stats) return;
+        flattenTree();
         
         std::cout << "\n--- Conversion Statistics ---\n";
         std::cout << "Total keys: " << config_data.size() << "\n";
@@ -481,21 +927,18 @@ public:
     int convert() {
         try {
             // Read input
-            std::string content;
+            std::ostringstream buffer;
             if (input_file.empty() || input_file == "-") {
-                std::string line;
-                while (std::getline(std::cin, line)) {
-                    content += line + "\n";
-                }
+                buffer << std::cin.rdbuf();
             } else {
-                std::ifstream file(input_file);
+                std::ifstream file(input_file, std::ios::binary);
                 if (!file.is_open()) {
                     std::cerr << "conf-convert: cannot open input file '" << input_file << "'\n";
                     return 1;
                 }
-                content.assign((std::istreambuf_iterator<char>(file)),
-                              std::istreambuf_iterator<char>());
+                buffer << file.rdbuf();
             }
+            std::string content = buffer.str();
             
             // Auto-detect input format
             if (input_format == "auto") {
@@ -528,8 +971,22 @@ public:
                 return 0;
             }
             
-            // Filter keys
-            filterKeys();
+            // JSON input keeps its nesting in JSON and YAML output; other
+            // formats get it flattened
+            bool nested = output_format == "json" || output_format == "yaml" || output_format == "yml";
+            if (have_tree && nested) {
+                std::string path;
+                if (!include_keys.empty() || !exclude_keys.empty()) {
+                    filterTree(json_root, path, include_keys.empty());
+                }
+                if (sort_keys) {
+                    sortTree(json_root);
+                }
+            } else {
+                flattenTree();
+                // Filter keys
+                filterKeys();
+            }
             
             // Sort keys if requested
             if (sort_keys) {
@@ -539,7 +996,13 @@ public:
             
             // Generate output
             std::string output;
-            if (output_format == "json") {
+            if (have_tree) {
+                if (output_format == "json") {
+                    writeJsonTree(output, json_root, 0);
+                } else {
+                    writeYamlTree(output, json_root, 0);
+                }
+            } else if (output_format == "json") {
                 output = generateJSON();
             } else if (output_format == "yaml" || output_format == "yml") {
                 output = generateYAML();
@@ -13,13 +13,19 @@
 
 #include <iostream>
 #include <string>
-#include <chrono>
-#include <thread>
 #include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <cstdint>
+#include <vector>
+#include <time.h>
 #include <signal.h>
 #include <getopt.h>
 #include <unistd.h>
 
+#include "../common/repeat_output.h"
+
 class NoUtility {
 private:
     std::string output_text = "no";
@@ -63,30 +69,152 @@ public:
     }
     
     int run() {
-        if (!quiet) {
-            std::string formatted = formatOutput();
+        if (quiet || count == 0) {
+            return 0;
+        }
+        
+        std::string formatted = formatOutput();
+        
+        if (delay_ms > 0) {
+            return runDelayed(formatted);
+        }
+        return runBatched(formatted);
+    }
+    
+private:
+    // Pre-render the response into a block of whole lines and push it with
+    // the same engine as yes, trimming the last write so --count is exact
+    int runBatched(const std::string& formatted) {
+        std::string line = formatted + "\n";
+        size_t copies;
+        char* block = alloc_block(line.size(), &copies);
+        if (!block) {
+            throw std::bad_alloc();
+        }
+        std::memcpy(block, line.data(), line.size());
+        replicate_block(block, line.size(), copies);
+        
+        struct output out;
+        setup_output(&out, STDOUT_FILENO);
+        
+        long long remaining = count;  // -1 means infinite
+        int status = 0;
+        while (running && remaining != 0) {
+            size_t lines = copies;
+            if (remaining > 0 && static_cast<unsigned long long>(remaining) < lines) {
+                lines = static_cast<size_t>(remaining);
+            }
             
-            if (count == -1) {
-                // Infinite loop
-                while (running) {
-                    std::cout << formatted << std::endl;
-                    
-                    if (delay_ms > 0) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
-                    }
+            if (emit(&out, block, lines * line.size()) < 0) {
+                if (errno != EPIPE) {
+                    std::cerr << "no: write error: " << std::strerror(errno) << std::endl;
+                    status = 1;
                 }
-            } else {
-                // Limited count
-                for (int i = 0; i < count && running; ++i) {
-                    std::cout << formatted << std::endl;
-                    
-                    if (delay_ms > 0 && i < count - 1) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
-                    }
+                break;
+            }
+            
+            if (remaining > 0) {
+                remaining -= lines;
+            }
+        }
+        
+        close_output(&out);
+        free(block);
+        return status;
+    }
+    
+    static int64_t monotonicNs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+    
+    // Sleep until an absolute CLOCK_MONOTONIC deadline, so neither the write
+    // nor scheduler jitter of one period carries over into the next
+    void sleepUntil(int64_t deadline_ns) {
+        timespec deadline;
+        deadline.tv_sec = deadline_ns / 1000000000LL;
+        deadline.tv_nsec = deadline_ns % 1000000000LL;
+        while (running &&
+               clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+        }
+    }
+    
+    // One flushed line per period, only used with --delay. Deadlines are
+    // start + k * period; a deadline that has already passed is reported
+    // and skipped rather than caught up with a burst.
+    int runDelayed(const std::string& formatted) {
+        const int64_t period = static_cast<int64_t>(delay_ms) * 1000000LL;
+        int64_t next = monotonicNs();
+        
+        for (long long i = 0; running && (count == -1 || i < count); ++i) {
+            if (i > 0) {
+                sleepUntil(next);
+                if (!running) {
+                    break;
                 }
             }
+            
+            std::cout << formatted << std::endl;
+            
+            next += period;
+            int64_t now = monotonicNs();
+            if (now > next) {
+                int64_t missed = (now - next) / period + 1;
+                std::cerr << "no: missed " << missed << " deadline(s), "
+                          << (now - next) / 1000 << " us late" << std::endl;
+                next += missed * period;
+            }
         }
         
+        return 0;
+    }
+    
+public:
+    // Hidden --jitter-bench: wake on the --delay cadence (10 ms by default)
+    // without writing, and print how late each wakeup was
+    int runJitterBenchmark() {
+        const int64_t period = static_cast<int64_t>(delay_ms > 0 ? delay_ms : 10) * 1000000LL;
+        const int ticks = count > 0 ? count : 500;
+        const int64_t bounds_us[] = {10, 50, 100, 250, 500, 1000, 5000};
+        const size_t num_bounds = sizeof(bounds_us) / sizeof(bounds_us[0]);
+        std::vector<int> histogram(num_bounds + 1, 0);
+        int64_t worst = 0;
+        int64_t total = 0;
+        int done = 0;
+        
+        std::cout << "no: measuring " << ticks << " wakeups every "
+                  << period / 1000000 << " ms" << std::endl;
+        
+        int64_t next = monotonicNs() + period;
+        for (; done < ticks && running; ++done) {
+            sleepUntil(next);
+            int64_t late_us = (monotonicNs() - next) / 1000;
+            size_t bucket = 0;
+            while (bucket < num_bounds && late_us >= bounds_us[bucket]) {
+                ++bucket;
+            }
+            ++histogram[bucket];
+            worst = std::max(worst, late_us);
+            total += late_us;
+            next += period;
+        }
+        
+        if (done == 0) {
+            return 0;
+        }
+        
+        std::cout << "\nWakeup latency (us)   count\n";
+        for (size_t i = 0; i <= num_bounds; ++i) {
+            std::string label = i < num_bounds
+                ? "< " + std::to_string(bounds_us[i])
+                : ">= " + std::to_string(bounds_us[num_bounds - 1]);
+            label.resize(20, ' ');
+            std::cout << "  " << label << std::to_string(histogram[i]) << "\t"
+                      << std::string(histogram[i] * 50 / done, '#') << "\n";
+        }
+        std::cout << "\nmean " << total / done << " us, max " << worst << " us\n";
+        
         return 0;
     }
 };
@@ -104,7 +232,8 @@ void printUsage(const char* program_name) {
     std::cout << "Usage: " << program_name << " [OPTIONS] [STRING]\n\n"
               << "The opposite of yes - outputs 'no' repeatedly until terminated.\n\n"
               << "Options:\n"
-              << "  -d, --delay=MS           Delay between outputs in milliseconds\n"
+              << "  -d, --delay=MS           Output once every MS milliseconds, on a fixed\n"
+              << "                           cadence; missed deadlines are reported on stderr\n"
               << "  -c, --count=N            Output N times instead of infinitely\n"
               << "  -u, --uppercase          Output in UPPERCASE\n"
               << "  -e, --enthusiastic       Be enthusiastic about saying no (NO!)\n"
@@ -170,11 +299,13 @@ int main(int argc, char* argv[]) {
         {"help",         no_argument,       0, 'h'},
         {"version",      no_argument,       0, 'v'},
         {"easter-egg",   no_argument,       0, 6001}, // Hidden option
+        {"jitter-bench", no_argument,       0, 6002}, // Hidden option
         {0, 0, 0, 0}
     };
     
     int opt;
     int option_index = 0;
+    bool jitter_bench = false;
     
     while ((opt = getopt_long(argc, argv, "d:c:uepsqhv", long_options, &option_index)) != -1) {
         switch (opt) {
@@ -223,6 +354,9 @@ int main(int argc, char* argv[]) {
             case 6001: // easter-egg
                 printEasterEgg();
                 return 0;
+            case 6002: // jitter-bench
+                jitter_bench = true;
+                break;
             case '?':
                 std::cerr << "Try '" << argv[0] << " --help' for more information.\n";
                 return 1;
@@ -237,6 +371,9 @@ int main(int argc, char* argv[]) {
     }
     
     try {
+        if (jitter_bench) {
+            return no_util.runJitterBenchmark();
+        }
         return no_util.run();
     } catch (const std::exception& e) {
         std::cerr << "no: error: " << e.what() << std::endl;
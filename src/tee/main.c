@@ -17,6 +17,7 @@
  * limitations under the License.
  */
 
+ #define _GNU_SOURCE
  #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
@@ -25,54 +26,2081 @@
  #include <signal.h>
  #include <errno.h>
  #include <sys/types.h>
+ #include <sys/stat.h>
+ #include <sys/syscall.h>
+ #include <linux/futex.h>
  #include <getopt.h>
+ #include <limits.h>
+ #include <poll.h>
+ #include <time.h>
+ #include <pthread.h>
+ #include <stdatomic.h>
  
- #define BUFFER_SIZE 4096
+ #include "../common/uring.h"
+ #include "../common/gzip.h"
+ 
+ #define BUFFER_SIZE 4096                    /* relay drain fallback chunk */
+ #define MIN_BUFFER_SIZE (64 * 1024)         /* copy path start when stdin is not a pipe */
+ #define MAX_BUFFER_SIZE (4 * 1024 * 1024)   /* adaptive copy buffer ceiling */
+ #define DEFAULT_RING_SIZE 64                /* queued chunks per sink in -t mode */
+ #define DIRECT_ALIGN 4096                   /* O_DIRECT offset, length and address alignment */
+ #define DIRECT_BUFFER_SIZE (1024 * 1024)    /* --direct bounce buffer per file */
+ #define DIRECT_TAIL_MS 100                  /* --direct: show a held tail after this much idle */
+ #define DEFAULT_COMPRESS_LEVEL 1            /* favour throughput over ratio */
+ #define DEFAULT_LINE_TIMEOUT_MS 50          /* -l: hold a partial line at most this long */
  #define VERSION "1.0.0"
  #define PACKAGE "QCO MoreUtils"
  
- /* Command line option flags */
- static int append_flag = 0;        /* -a, --append */
- static int ignore_interrupts = 0;  /* -i, --ignore-interrupts */
- static int output_linebuffered = 0; /* -l, --line-buffered */
- static int verbose_mode = 0;       /* -v, --verbose */
+ /* Command line option flags */
+ static int append_flag = 0;        /* -a, --append */
+ static int ignore_interrupts = 0;  /* -i, --ignore-interrupts */
+ static int output_linebuffered = 0; /* -l, --line-buffered */
+ static int verbose_mode = 0;       /* -v, --verbose */
+ static size_t buffer_size = 0;     /* -b, --buffer-size (0: adaptive) */
+ static size_t pipe_size_request = 0; /* -p, --pipe-size */
+ static int threaded_mode = 0;      /* -t, --threads */
+ static unsigned int ring_size = DEFAULT_RING_SIZE; /* --ring-size */
+ static int uring_mode = 0;         /* --io-uring */
+ static size_t sync_bytes = 0;      /* --sync-bytes */
+ static long sync_interval_ms = 0;  /* --sync-interval */
+ static int direct_mode = 0;        /* --direct */
+ static int compress_all = 0;       /* -z, --compress */
+ static int compress_level = DEFAULT_COMPRESS_LEVEL; /* --compress-level */
+ static size_t rotate_bytes = 0;    /* --rotate-bytes */
+ static double rotate_seconds = 0;  /* --rotate-seconds */
+ static const char *rotate_name = NULL; /* --rotate-name (default FILE.%N) */
+ static int rotate_lines = 0;       /* --rotate-lines */
+ static long line_timeout_ms = DEFAULT_LINE_TIMEOUT_MS; /* --line-timeout */
+ static int stats_mode = 0;         /* --stats */
+ static int stats_fd = STDERR_FILENO;
+ static const char *engine_name = "read/write";
+ 
+ /* What a writer thread's full queue does to the reader (--lag-policy) */
+ enum lag_policy {
+     LAG_BLOCK,   /* wait for the sink to catch up */
+     LAG_DROP,    /* skip the chunk for that sink and count it */
+     LAG_DETACH   /* stop feeding that sink altogether */
+ };
+ 
+ static const char *lag_policy_names[] = { "block", "drop", "detach" };
+ static enum lag_policy lag_policy = LAG_BLOCK;
+ 
+ /* Reference-counted block of input shared by the writer threads */
+ struct chunk {
+     atomic_int refs;   /* writers still to finish with it; 0 when free */
+     size_t len;
+     char *data;
+ };
+ 
+ /* Bounded single-producer/single-consumer queue of chunks for one sink */
+ struct sink_queue {
+     struct chunk **slots;
+     unsigned int mask;
+     atomic_uint head;            /* advanced by the reader */
+     atomic_uint tail;            /* advanced by the sink's writer */
+     atomic_int consumer_waiting;
+     atomic_int producer_waiting;
+     atomic_int closed;
+ };
+ 
+ /*
+  * --stats counters for one side of the copy. Each is written by a single
+  * thread (the reader, or the thread writing that sink) and only read by
+  * the snapshot, so relaxed loads and stores are enough and compile to
+  * plain moves. Timing is taken around each syscall only with --stats.
+  */
+ struct io_stats {
+     atomic_ullong bytes;
+     atomic_ullong calls;       /* read/write/splice calls that moved data */
+     atomic_ullong wait_ns;     /* total time spent inside those calls */
+     atomic_ullong busy_since;  /* start of the call in progress, 0 if none */
+     atomic_ullong short_calls; /* writes that moved less than asked */
+     atomic_ullong retries;     /* calls restarted after EINTR or EAGAIN */
+ };
+ 
+ static struct io_stats input_stats;
+ 
+ /* One output destination; sinks[0] is standard output */
+ struct sink {
+     const char *name;
+     int fd;          /* -1 once closed after an error */
+     int relay[2];    /* internal pipe used by the splice path */
+     int no_splice;   /* kernel refused splice(2) into fd, use write(2) */
+     struct io_stats stats;
+ 
+     /* Threaded path */
+     struct sink_queue queue;
+     pthread_t thread;
+     int has_thread;
+     atomic_int attached;   /* still being fed chunks */
+     int detached;          /* cut off by the detach policy (reader only) */
+     unsigned int max_lag;  /* deepest queue seen, in chunks */
+     unsigned long long bytes_written;
+     unsigned long long bytes_dropped;
+     double seconds;
+ 
+     /* Durable output */
+     int direct;                  /* fd is open with O_DIRECT */
+     char *bounce;                /* aligned staging buffer for O_DIRECT */
+     size_t bounce_len;
+     size_t bounce_shown;         /* leading bounce bytes already in the file */
+     double bounce_since;         /* when the rest started waiting */
+     unsigned long long unsynced; /* bytes written since the last fdatasync */
+     double last_sync;
+     double *sync_latency;        /* seconds taken by each fdatasync */
+     size_t sync_count, sync_capacity;
+ 
+     /* Compressed output, written by the sink's own thread */
+     int compress;
+     struct gzip_stream gz;
+ 
+     /* Rotation */
+     char *dir;                   /* where the next segment is pre-created */
+     atomic_int next_fd;          /* pre-created O_TMPFILE segment, or -1 */
+     int no_tmpfile;              /* O_TMPFILE unsupported: rotate in place */
+     int rotations_pending;       /* jobs queued for the rotator thread */
+     unsigned long long segment_bytes;
+     double segment_start;        /* monotonic clock */
+     time_t segment_wall;         /* wall clock, for --rotate-name */
+     unsigned int segment_count;
+     int at_line_start;           /* last byte written was a newline */
+ };
+ 
+ static struct sink *sinks = NULL;
+ static int num_sinks = 0;
+ static atomic_int output_failed;   /* an output was lost or incomplete: exit 1 */
+ 
+ /* Help information */
+ static void print_help(void) {
+     printf("Usage: tee [OPTION]... [FILE]...\n");
+     printf("Read from standard input and write to both standard output and files.\n\n");
+     printf("  -a, --append              append to the given FILEs, do not overwrite\n");
+     printf("  -i, --ignore-interrupts   ignore interrupt signals\n");
+     printf("  -l, --line-buffered       write only whole lines to each output, holding a\n");
+     printf("                            partial line back until its newline arrives\n");
+     printf("      --line-timeout=MS     with -l, send a partial line after MS ms anyway\n");
+     printf("                            (default %d)\n", DEFAULT_LINE_TIMEOUT_MS);
+     printf("  -v, --verbose             print diagnostic messages\n");
+     printf("  -b, --buffer-size=SIZE    copy through a fixed SIZE buffer instead of\n");
+     printf("                            growing it from the pipe capacity up to 4M\n");
+     printf("  -p, --pipe-size=SIZE      raise the stdin pipe capacity to SIZE\n");
+     printf("  -t, --threads             give every output its own writer thread\n");
+     printf("      --lag-policy=POLICY   when a file falls --ring-size chunks behind in\n");
+     printf("                            -t mode: block (default), drop, or detach\n");
+     printf("      --ring-size=N         chunks queued per output in -t mode (default %d)\n",
+            DEFAULT_RING_SIZE);
+     printf("      --io-uring            submit each chunk's writes as one io_uring batch\n");
+     printf("      --sync-bytes=SIZE     fdatasync a file after every SIZE bytes written\n");
+     printf("      --sync-interval=MS    fdatasync a file at most MS ms after a write\n");
+     printf("      --direct              write files with O_DIRECT through aligned buffers\n");
+     printf("  -z, --compress            gzip every FILE (FILEs ending in .gz always are)\n");
+     printf("      --compress-level=N    gzip level 1-9 (default %d)\n", DEFAULT_COMPRESS_LEVEL);
+     if (strcmp(gzip_engine(), "zlib") != 0) {
+         printf("                            (no effect in this build: without zlib\n");
+         printf("                            the built-in encoder has a single level)\n");
+     }
+     printf("      --rotate-bytes=SIZE   start a new FILE after SIZE bytes of input\n");
+     printf("      --rotate-seconds=T    start a new FILE after T seconds\n");
+     printf("      --rotate-name=PATTERN name finished FILEs by PATTERN: strftime(3)\n");
+     printf("                            conversions for their start time and %%N for\n");
+     printf("                            the sequence number (default FILE.N)\n");
+     printf("      --rotate-lines        only start a new FILE after a newline\n");
+     printf("      --stats[=FILE]        write I/O counters as JSON lines to FILE (default\n");
+     printf("                            standard error) on SIGUSR1 and at exit\n");
+     printf("      --help                display this help and exit\n");
+     printf("      --version             output version information and exit\n");
+     printf("\nSIZE may carry a K, M or G suffix.\n");
+     printf("\nWhen standard input is a pipe, data is duplicated in the kernel with\n");
+     printf("tee(2) and splice(2) instead of being copied through a user buffer.\n");
+     printf("Compressed FILEs imply -t so compression never holds up standard output.\n");
+     printf("\nPart of %s package, version %s\n", PACKAGE, VERSION);
+     printf("Author: AnmiTaliDev\n");
+     printf("License: Apache 2.0\n");
+ }
+ 
+ /* Version information */
+ static void print_version(void) {
+     printf("tee (QCO MoreUtils) %s\n", VERSION);
+     printf("Copyright (C) 2025 AnmiTaliDev\n");
+     printf("License: Apache 2.0\n");
+ }
+ 
+ /* SIGINT or SIGTERM received. The handler only notes it; the blocking
+  * call it interrupts fails with EINTR and the copy loop then stops as if
+  * input had ended, so every file is finished (gzip trailer, --direct
+  * tail, last sync) on the way out. A write it interrupts gives up on
+  * that output instead: one that is not being read would otherwise hold
+  * tee forever. Atomic because the writer threads (-t) read it too. */
+ static atomic_int stop_signal;
+ 
+ static void signal_handler(int sig) {
+     atomic_store(&stop_signal, sig);
+ }
+ 
+ /* How long a stopping tee waits for an output that makes no progress */
+ #define STOP_WAIT_MS 100
+ 
+ /* Sent to a writer thread (-t) after a stop signal, to interrupt a write
+  * it is blocked in; ignored by default, so a stray one does no harm */
+ #define WAKE_SIGNAL SIGURG
+ 
+ static void wake_handler(int sig) {
+     (void)sig;
+ }
+ 
+ /* Start a thread with SIGINT and SIGTERM blocked, so they are always
+  * delivered to the main thread, the one that waits for input */
+ static int start_thread(pthread_t *thread, void *(*fn)(void *), void *arg) {
+     sigset_t set, old;
+     int rc;
+ 
+     sigemptyset(&set);
+     sigaddset(&set, SIGINT);
+     sigaddset(&set, SIGTERM);
+     pthread_sigmask(SIG_BLOCK, &set, &old);
+     rc = pthread_create(thread, NULL, fn, arg);
+     pthread_sigmask(SIG_SETMASK, &old, NULL);
+     return rc;
+ }
+ 
+ static unsigned long long now_ns(void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+ }
+ 
+ static void stat_add(atomic_ullong *counter, unsigned long long n) {
+     atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                           memory_order_relaxed);
+ }
+ 
+ /* Mark a syscall on st as started; returns its start time, 0 without --stats */
+ static unsigned long long stat_begin(struct io_stats *st) {
+     unsigned long long t;
+ 
+     if (!stats_mode || !st) {
+         return 0;
+     }
+     t = now_ns();
+     atomic_store_explicit(&st->busy_since, t, memory_order_relaxed);
+     return t;
+ }
+ 
+ /* Account a finished syscall: result is its return value and asked the
+  * byte count a write wanted to move (0 for reads). errno is preserved. */
+ static void stat_end(struct io_stats *st, unsigned long long start, ssize_t result, size_t asked) {
+     int saved = errno;
+ 
+     if (!start) {
+         return;
+     }
+     stat_add(&st->wait_ns, now_ns() - start);
+     atomic_store_explicit(&st->busy_since, 0, memory_order_relaxed);
+     if (result > 0) {
+         stat_add(&st->bytes, (unsigned long long)result);
+         stat_add(&st->calls, 1);
+         if ((size_t)result < asked) {
+             stat_add(&st->short_calls, 1);
+         }
+     } else if (result < 0 && (saved == EINTR || saved == EAGAIN)) {
+         stat_add(&st->retries, 1);
+     }
+     errno = saved;
+ }
+ 
+ /* Write the whole buffer, retrying on short writes and EINTR; -1 with
+  * EINTR if a stop signal interrupted it */
+ static int write_all(int fd, const char *data, size_t len, struct io_stats *st) {
+     while (len > 0) {
+         unsigned long long t = stat_begin(st);
+         ssize_t written = write(fd, data, len);
+         stat_end(st, t, written, len);
+         if (written < 0) {
+             if (errno == EINTR && !stop_signal) {
+                 continue;
+             }
+             return -1;
+         }
+         data += written;
+         len -= (size_t)written;
+     }
+     return 0;
+ }
+ 
+ /* Report a failed file sink and stop writing to it */
+ static void drop_sink(struct sink *s) {
+     fprintf(stderr, "tee: %s: %s\n", s->name, strerror(errno));
+     atomic_store(&output_failed, 1);
+     close(s->fd);
+     s->fd = -1;
+ }
+ 
+ /* Parse a byte count with an optional K, M or G suffix; 0 on error */
+ static size_t parse_size(const char *text) {
+     char *end;
+     unsigned long long value = strtoull(text, &end, 10);
+ 
+     switch (*end) {
+         case 'k': case 'K': value <<= 10; end++; break;
+         case 'm': case 'M': value <<= 20; end++; break;
+         case 'g': case 'G': value <<= 30; end++; break;
+     }
+     if (end == text || *end != '\0') {
+         return 0;
+     }
+     return (size_t)value;
+ }
+ 
+ static double now_seconds(void) {
+     struct timespec ts;
+     clock_gettime(CLOCK_MONOTONIC, &ts);
+     return ts.tv_sec + ts.tv_nsec / 1e9;
+ }
+ 
+ /*
+  * Durable file output. With --sync-bytes/--sync-interval every file
+  * collects writes and calls fdatasync(2) once the unsynced byte count or
+  * the time since its last sync crosses the threshold; each sync's
+  * latency is kept for the report at exit. With --direct, files are
+  * opened O_DIRECT and fed through an aligned bounce buffer, written in
+  * whole DIRECT_ALIGN blocks; a tail that waits there DIRECT_TAIL_MS
+  * for more input is written out buffered meanwhile.
+  */
+ static int durable_mode(void) {
+     return sync_bytes > 0 || sync_interval_ms > 0;
+ }
+ 
+ static int rotation_mode(void) {
+     return rotate_bytes > 0 || rotate_seconds > 0;
+ }
+ 
+ /* Options that only the read/write and threaded paths implement */
+ static int copy_options_active(void) {
+     return durable_mode() || direct_mode || rotation_mode() || output_linebuffered;
+ }
+ 
+ static int sync_due(const struct sink *s, double now) {
+     return sync_interval_ms > 0 && s->unsynced > 0 &&
+            (now - s->last_sync) * 1000 >= sync_interval_ms;
+ }
+ 
+ /* Milliseconds until a file's time-based sync is due, or -1 if none is */
+ static int sync_timeout(const struct sink *s, double now) {
+     double left;
+ 
+     if (sync_interval_ms == 0 || s->fd == -1 || s->unsynced == 0) {
+         return -1;
+     }
+     left = s->last_sync + sync_interval_ms / 1000.0 - now;
+     return left > 0 ? (int)(left * 1000) + 1 : 0;
+ }
+ 
+ /* Milliseconds until the unshown tail of a --direct file's bounce buffer
+  * is due to be written out, or -1 if there is none */
+ static int tail_timeout(const struct sink *s, double now) {
+     double left;
+ 
+     if (!s->direct || s->fd == -1 || s->bounce_len <= s->bounce_shown) {
+         return -1;
+     }
+     left = s->bounce_since + DIRECT_TAIL_MS / 1000.0 - now;
+     return left > 0 ? (int)(left * 1000) + 1 : 0;
+ }
+ 
+ /* Milliseconds until a file has to be visited while input is idle */
+ static int idle_timeout(const struct sink *s, double now) {
+     int sync_ms = sync_timeout(s, now);
+     int tail_ms = tail_timeout(s, now);
+ 
+     return sync_ms < 0 || (tail_ms >= 0 && tail_ms < sync_ms) ? tail_ms : sync_ms;
+ }
+ 
+ /* The earliest idle_timeout() among the files */
+ static int next_sync_timeout(void) {
+     double now = now_seconds();
+     int timeout = -1;
+ 
+     for (int i = 1; i < num_sinks; i++) {
+         int ms = idle_timeout(&sinks[i], now);
+         if (ms >= 0 && (timeout < 0 || ms < timeout)) {
+             timeout = ms;
+         }
+     }
+     return timeout;
+ }
+ 
+ /* Write the aligned part of the bounce buffer with O_DIRECT and keep the
+  * rest at its start. With with_tail, the unaligned rest is also made
+  * visible: a buffered pwrite(2) at the current offset writes it without
+  * moving that offset, and the next aligned write simply covers the same
+  * bytes again. */
+ static int flush_bounce(struct sink *s, int with_tail) {
+     size_t aligned = s->bounce_len & ~(size_t)(DIRECT_ALIGN - 1);
+ 
+     if (aligned > 0) {
+         if (write_all(s->fd, s->bounce, aligned, &s->stats) < 0) {
+             return -1;
+         }
+         memmove(s->bounce, s->bounce + aligned, s->bounce_len - aligned);
+         s->bounce_len -= aligned;
+         s->bounce_shown = s->bounce_shown > aligned ? s->bounce_shown - aligned : 0;
+     }
+ 
+     if (with_tail && s->bounce_len > 0) {
+         off_t pos = lseek(s->fd, 0, SEEK_CUR);
+         int flags = fcntl(s->fd, F_GETFL);
+         size_t done = 0;
+ 
+         if (pos < 0 || flags < 0 || fcntl(s->fd, F_SETFL, flags & ~O_DIRECT) < 0) {
+             return -1;
+         }
+         while (done < s->bounce_len) {
+             ssize_t n = pwrite(s->fd, s->bounce + done, s->bounce_len - done, pos + done);
+             if (n < 0 && errno != EINTR) {
+                 fcntl(s->fd, F_SETFL, flags);
+                 return -1;
+             }
+             done += n > 0 ? (size_t)n : 0;
+         }
+         fcntl(s->fd, F_SETFL, flags);
+         s->bounce_shown = s->bounce_len;
+     }
+     return 0;
+ }
+ 
+ static int sink_sync(struct sink *s) {
+     double start;
+ 
+     if (s->direct && flush_bounce(s, 1) < 0) {
+         return -1;
+     }
+ 
+     start = now_seconds();
+     if (fdatasync(s->fd) < 0 && errno != EINVAL && errno != EROFS) {
+         return -1;  /* EINVAL/EROFS: pipes and devices have nothing to sync */
+     }
+     s->last_sync = now_seconds();
+     s->unsynced = 0;
+ 
+     if (s->sync_count == s->sync_capacity) {
+         size_t capacity = s->sync_capacity ? s->sync_capacity * 2 : 256;
+         double *grown = realloc(s->sync_latency, capacity * sizeof(double));
+         if (!grown) {
+             return 0;  /* the sync happened, only the statistic is lost */
+         }
+         s->sync_latency = grown;
+         s->sync_capacity = capacity;
+     }
+     s->sync_latency[s->sync_count++] = s->last_sync - start;
+     return 0;
+ }
+ 
+ /* Write to a file sink, honouring --direct and the sync thresholds */
+ static int sink_output(struct sink *s, const char *data, size_t len) {
+     if (s->direct) {
+         size_t left = len;
+         if (s->bounce_len <= s->bounce_shown) {
+             s->bounce_since = now_seconds();
+         }
+         while (left > 0) {
+             size_t n = DIRECT_BUFFER_SIZE - s->bounce_len;
+             if (n > left) {
+                 n = left;
+             }
+             memcpy(s->bounce + s->bounce_len, data, n);
+             s->bounce_len += n;
+             data += n;
+             left -= n;
+             if (s->bounce_len == DIRECT_BUFFER_SIZE && flush_bounce(s, 0) < 0) {
+                 return -1;
+             }
+         }
+     } else if (write_all(s->fd, data, len, &s->stats) < 0) {
+         return -1;
+     }
+ 
+     if (durable_mode()) {
+         s->unsynced += len;
+         if ((sync_bytes > 0 && s->unsynced >= sync_bytes) || sync_due(s, now_seconds())) {
+             return sink_sync(s);
+         }
+     }
+     return 0;
+ }
+ 
+ static int sink_output_cb(void *ctx, const char *data, size_t len) {
+     return sink_output(ctx, data, len);
+ }
+ 
+ /*
+  * Rotation. The live segment is always written under FILE. The next
+  * segment is pre-created as an unnamed O_TMPFILE, so a rotation on the
+  * hot path only swaps descriptors; the rotator thread then renames the
+  * finished FILE by --rotate-name, links the new segment in as FILE,
+  * syncs and closes the old one, and pre-creates the following segment.
+  * Filesystems without O_TMPFILE rename and reopen FILE in place instead,
+  * still leaving sync and close to the rotator.
+  */
+ struct rotation_job {
+     struct sink *s;
+     int old_fd;
+     int new_fd;          /* segment to link in as FILE; -1 if done in place */
+     char *rotated_name;  /* already holds the data when new_fd is -1 */
+     unsigned long long bytes;
+     struct rotation_job *next;
+ };
+ 
+ static pthread_mutex_t rotation_lock = PTHREAD_MUTEX_INITIALIZER;
+ static pthread_cond_t rotation_cond = PTHREAD_COND_INITIALIZER;
+ static struct rotation_job *rotation_head = NULL, *rotation_tail = NULL;
+ static int rotation_stop = 0;
+ static pthread_t rotation_thread;
+ static int rotation_started = 0;
+ 
+ static int open_segment(struct sink *s) {
+     int flags = O_WRONLY | (s->direct ? O_DIRECT : 0);
+ 
+     if (s->no_tmpfile) {
+         return -1;
+     }
+     int fd = open(s->dir, flags | O_TMPFILE, 0666);
+     if (fd < 0 && (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL)) {
+         s->no_tmpfile = 1;
+     }
+     return fd;
+ }
+ 
+ /* Name for the segment that is being finished: FILE.N by default, else
+  * --rotate-name with %N replaced by N and the rest left to strftime(3) */
+ static char *rotated_name(const struct sink *s) {
+     char expanded[PATH_MAX], result[PATH_MAX];
+     size_t out = 0;
+     struct tm tm;
+ 
+     if (!rotate_name) {
+         snprintf(result, sizeof(result), "%s.%u", s->name, s->segment_count);
+         return strdup(result);
+     }
+ 
+     for (const char *p = rotate_name; *p && out < sizeof(expanded) - 1; p++) {
+         if (p[0] == '%' && p[1] == 'N') {
+             int n = snprintf(expanded + out, sizeof(expanded) - out, "%u", s->segment_count);
+             out += (size_t)n < sizeof(expanded) - out ? (size_t)n : sizeof(expanded) - 1 - out;
+             p++;
+         } else if (p[0] == '%' && p[1] != '\0') {
+             expanded[out++] = *p++;     /* keep %% and other conversions whole */
+             if (out < sizeof(expanded) - 1) {
+                 expanded[out++] = *p;
+             }
+         } else {
+             expanded[out++] = *p;
+         }
+     }
+     expanded[out] = '\0';
+ 
+     localtime_r(&s->segment_wall, &tm);
+     if (strftime(result, sizeof(result), expanded, &tm) == 0) {
+         return NULL;
+     }
+     return strdup(result);
+ }
+ 
+ static void *rotator(void *arg) {
+     (void)arg;
+     pthread_mutex_lock(&rotation_lock);
+     for (;;) {
+         struct rotation_job *job = rotation_head;
+         if (!job) {
+             if (rotation_stop) {
+                 break;
+             }
+             pthread_cond_wait(&rotation_cond, &rotation_lock);
+             continue;
+         }
+         rotation_head = job->next;
+         if (!rotation_head) {
+             rotation_tail = NULL;
+         }
+         pthread_mutex_unlock(&rotation_lock);
+ 
+         struct sink *s = job->s;
+         if (job->new_fd != -1) {
+             char path[64];
+             snprintf(path, sizeof(path), "/proc/self/fd/%d", job->new_fd);
+             if (rename(s->name, job->rotated_name) < 0) {
+                 fprintf(stderr, "tee: %s: %s\n", job->rotated_name, strerror(errno));
+                 atomic_store(&output_failed, 1);
+             }
+             if (linkat(AT_FDCWD, path, AT_FDCWD, s->name, AT_SYMLINK_FOLLOW) < 0) {
+                 fprintf(stderr, "tee: %s: %s\n", s->name, strerror(errno));
+                 atomic_store(&output_failed, 1);
+             }
+             close(job->new_fd);   /* the sink writes through its own descriptor */
+         }
+         if (durable_mode() && fdatasync(job->old_fd) < 0 && errno != EINVAL) {
+             fprintf(stderr, "tee: %s: %s\n", job->rotated_name, strerror(errno));
+             atomic_store(&output_failed, 1);
+         }
+         if (close(job->old_fd) < 0) {
+             fprintf(stderr, "tee: %s: %s\n", job->rotated_name, strerror(errno));
+             atomic_store(&output_failed, 1);
+         }
+         if (verbose_mode) {
+             fprintf(stderr, "tee: %s: rotated %llu bytes to %s\n",
+                     s->name, job->bytes, job->rotated_name);
+         }
+ 
+         int next = open_segment(s);
+         if (next < 0 && !s->no_tmpfile) {
+             fprintf(stderr, "tee: %s: %s\n", s->dir, strerror(errno));
+         }
+         atomic_store(&s->next_fd, next);
+         free(job->rotated_name);
+         free(job);
+ 
+         pthread_mutex_lock(&rotation_lock);
+         s->rotations_pending--;
+         pthread_cond_broadcast(&rotation_cond);
+     }
+     pthread_mutex_unlock(&rotation_lock);
+     return NULL;
+ }
+ 
+ /* Prepare a file for rotation: remember its directory, pre-create the
+  * next segment, start the rotator thread on first use */
+ static int rotation_setup(struct sink *s) {
+     const char *slash = strrchr(s->name, '/');
+ 
+     s->dir = slash ? strndup(s->name, slash == s->name ? 1 : (size_t)(slash - s->name))
+                    : strdup(".");
+     if (!s->dir) {
+         return -1;
+     }
+     s->segment_start = now_seconds();
+     s->segment_wall = time(NULL);
+     s->segment_count = 1;
+     s->at_line_start = 1;
+     atomic_init(&s->next_fd, open_segment(s));
+     if (atomic_load(&s->next_fd) < 0 && verbose_mode) {
+         fprintf(stderr, "%s: no O_TMPFILE, rotating by rename and reopen\n", s->name);
+     }
+ 
+     if (!rotation_started) {
+         if (start_thread(&rotation_thread, rotator, NULL) != 0) {
+             return -1;
+         }
+         rotation_started = 1;
+     }
+     return 0;
+ }
+ 
+ /* Let the rotator finish its queue, drop unused pre-created segments */
+ static void rotation_shutdown(void) {
+     if (rotation_started) {
+         pthread_mutex_lock(&rotation_lock);
+         rotation_stop = 1;
+         pthread_cond_broadcast(&rotation_cond);
+         pthread_mutex_unlock(&rotation_lock);
+         pthread_join(rotation_thread, NULL);
+         rotation_started = 0;
+     }
+     for (int i = 1; i < num_sinks; i++) {
+         int fd = atomic_exchange(&sinks[i].next_fd, -1);
+         if (fd >= 0) {
+             close(fd);
+         }
+         free(sinks[i].dir);
+         sinks[i].dir = NULL;
+     }
+ }
+ 
+ /* Finish the current segment of s and switch it to a fresh one */
+ static int sink_rotate(struct sink *s) {
+     struct rotation_job *job = calloc(1, sizeof(*job));
+     int new_fd;
+ 
+     if (!job) {
+         return -1;
+     }
+     if ((s->compress && gzip_finish(&s->gz, sink_output_cb, s) < 0) ||
+         (s->direct && flush_bounce(s, 1) < 0) ||
+         !(job->rotated_name = rotated_name(s))) {
+         free(job);
+         return -1;
+     }
+ 
+     /* A previous rotation still pre-creating our next segment: wait */
+     pthread_mutex_lock(&rotation_lock);
+     while (s->rotations_pending > 0) {
+         pthread_cond_wait(&rotation_cond, &rotation_lock);
+     }
+     pthread_mutex_unlock(&rotation_lock);
+ 
+     new_fd = atomic_exchange(&s->next_fd, -1);
+     if (new_fd >= 0) {
+         job->new_fd = dup(new_fd);
+         if (job->new_fd < 0) {
+             close(new_fd);
+             new_fd = -1;
+         }
+     }
+     if (new_fd < 0) {
+         /* In place: FILE must be free before it is reopened */
+         job->new_fd = -1;
+         if (rename(s->name, job->rotated_name) < 0 ||
+             (new_fd = open(s->name, O_WRONLY | O_CREAT | O_TRUNC | (s->direct ? O_DIRECT : 0),
+                            0666)) < 0) {
+             free(job->rotated_name);
+             free(job);
+             return -1;
+         }
+     }
+ 
+     job->s = s;
+     job->old_fd = s->fd;
+     job->bytes = s->segment_bytes;
+     s->fd = new_fd;
+     s->bounce_len = 0;          /* its tail went to the old segment */
+     s->bounce_shown = 0;
+     s->segment_bytes = 0;
+     s->segment_start = now_seconds();
+     s->segment_wall = time(NULL);
+     s->segment_count++;
+     s->unsynced = 0;            /* the rotator syncs the old segment */
+     s->last_sync = s->segment_start;
+     if (s->compress) {
+         gzip_free(&s->gz);
+         if (gzip_init(&s->gz, compress_level) < 0) {
+             s->compress = 0;
+             errno = ENOMEM;
+             return -1;
+         }
+     }
+ 
+     pthread_mutex_lock(&rotation_lock);
+     s->rotations_pending++;
+     if (rotation_tail) {
+         rotation_tail->next = job;
+     } else {
+         rotation_head = job;
+     }
+     rotation_tail = job;
+     pthread_cond_broadcast(&rotation_cond);
+     pthread_mutex_unlock(&rotation_lock);
+     return 0;
+ }
+ 
+ /* Where to cut len bytes of input for rotation: an offset in [0, len],
+  * or (size_t)-1 when the segment goes on past them */
+ static size_t rotation_cut(const struct sink *s, const char *data, size_t len) {
+     size_t limit;
+     const char *nl;
+ 
+     if (rotate_bytes > 0 && s->segment_bytes + len >= rotate_bytes) {
+         limit = s->segment_bytes < rotate_bytes ? rotate_bytes - s->segment_bytes : 0;
+     } else if (rotate_seconds > 0 && s->segment_bytes > 0 &&
+                now_seconds() - s->segment_start >= rotate_seconds) {
+         limit = 0;
+     } else {
+         return (size_t)-1;
+     }
+     if (!rotate_lines) {
+         return limit;
+     }
+ 
+     /* Line-aware: the last newline before the limit, else the first one
+      * after it; no newline at all means no cut yet */
+     if (limit == 0 && s->at_line_start) {
+         return 0;
+     }
+     nl = limit > 0 ? memrchr(data, '\n', limit) : NULL;
+     if (!nl) {
+         nl = memchr(data + limit, '\n', len - limit);
+     }
+     return nl ? (size_t)(nl - data) + 1 : (size_t)-1;
+ }
+ 
+ /* Write part of one segment, through the compressor if there is one */
+ static int segment_write(struct sink *s, const char *data, size_t len) {
+     if (len == 0) {
+         return 0;
+     }
+     if (s->compress ? gzip_write(&s->gz, data, len, sink_output_cb, s) < 0
+                     : sink_output(s, data, len) < 0) {
+         return -1;
+     }
+     s->segment_bytes += len;
+     s->at_line_start = data[len - 1] == '\n';
+     return 0;
+ }
+ 
+ /* Write input to a file sink, rotating it where a segment ends */
+ static int sink_write(struct sink *s, const char *data, size_t len) {
+     if (!s->dir) {
+         return segment_write(s, data, len);
+     }
+     while (len > 0) {
+         size_t cut = rotation_cut(s, data, len);
+         if (cut == (size_t)-1) {
+             return segment_write(s, data, len);
+         }
+         if (segment_write(s, data, cut) < 0) {
+             return -1;
+         }
+         if (s->segment_bytes > 0 && sink_rotate(s) < 0) {
+             return -1;
+         }
+         data += cut;
+         len -= cut;
+     }
+     return 0;
+ }
+ 
+ /* Sync a file whose time threshold has passed, or else write out its
+  * --direct tail if that has waited long enough (idle input) */
+ static int idle_flush(struct sink *s, double now) {
+     if (sync_due(s, now)) {
+         return sink_sync(s);
+     }
+     if (tail_timeout(s, now) == 0) {
+         return flush_bounce(s, 1);
+     }
+     return 0;
+ }
+ 
+ static void sync_due_sinks(void) {
+     double now = now_seconds();
+ 
+     for (int i = 1; i < num_sinks; i++) {
+         if (sinks[i].fd != -1 && idle_flush(&sinks[i], now) < 0) {
+             drop_sink(&sinks[i]);
+         }
+     }
+ }
+ 
+ static int compare_double(const void *a, const void *b) {
+     double x = *(const double *)a, y = *(const double *)b;
+     return x < y ? -1 : x > y;
+ }
+ 
+ /* Flush what a file still holds, sync it a last time, report latencies */
+ static int sink_finish(struct sink *s) {
+     int status = 0;
+ 
+     if (s->compress) {
+         if (s->fd != -1 && gzip_finish(&s->gz, sink_output_cb, s) < 0) {
+             fprintf(stderr, "tee: %s: %s\n", s->name, strerror(errno));
+             status = -1;
+         } else if (verbose_mode && s->gz.bytes_in > 0) {
+             fprintf(stderr, "tee: %s: %llu bytes compressed to %llu (%.1f%%, %s)\n",
+                     s->name, s->gz.bytes_in, s->gz.bytes_out,
+                     100.0 * s->gz.bytes_out / s->gz.bytes_in, gzip_engine());
+         }
+         gzip_free(&s->gz);
+         s->compress = 0;
+     }
+ 
+     if (s->fd != -1) {
+         if ((s->direct && flush_bounce(s, 1) < 0) ||
+             (durable_mode() && s->unsynced > 0 && sink_sync(s) < 0)) {
+             fprintf(stderr, "tee: %s: %s\n", s->name, strerror(errno));
+             status = -1;
+         }
+     }
+ 
+     if (s->sync_count > 0) {
+         double *lat = s->sync_latency;
+         size_t n = s->sync_count;
+         qsort(lat, n, sizeof(double), compare_double);
+         fprintf(stderr, "tee: %s: %zu syncs, latency p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                 s->name, n, lat[(n - 1) * 50 / 100] * 1e3, lat[(n - 1) * 90 / 100] * 1e3,
+                 lat[(n - 1) * 99 / 100] * 1e3, lat[n - 1] * 1e3);
+     }
+ 
+     free(s->bounce);
+     free(s->sync_latency);
+     s->bounce = NULL;
+     s->sync_latency = NULL;
+     return status;
+ }
+ 
+ /*
+  * Line mode (-l). Outputs only ever get whole lines per write: the bytes
+  * after the last newline of a read are carried over and sent with the
+  * rest of their line. A tail still unfinished --line-timeout ms after it
+  * was first held back is sent on its own, as is one that fills the
+  * whole buffer, so a prompt or a very long line is never stuck.
+  */
+ /* Length of the complete lines in buf, given that its last fresh bytes
+  * were just read (the rest is a tail already known to hold no newline) */
+ static size_t complete_lines(const char *buf, size_t len, size_t fresh) {
+     const char *nl = memrchr(buf + len - fresh, '\n', fresh);
+     return nl ? (size_t)(nl - buf) + 1 : 0;
+ }
+ 
+ /* Milliseconds until a tail held back since `since` must be flushed */
+ static int line_timeout_left(double since) {
+     double left = since + line_timeout_ms / 1000.0 - now_seconds();
+     return left > 0 ? (int)(left * 1000) + 1 : 0;
+ }
+ 
+ /* Earlier of the --sync-interval and line tail deadlines for poll(2) */
+ static int input_timeout(size_t held, double held_since) {
+     int timeout = next_sync_timeout();
+ 
+     if (held > 0) {
+         int line_ms = line_timeout_left(held_since);
+         if (timeout < 0 || line_ms < timeout) {
+             timeout = line_ms;
+         }
+     }
+     return timeout;
+ }
+ 
+ /* Write a block of input to standard output and every file; -1 only if
+  * standard output failed */
+ static int copy_out(const char *data, size_t len) {
+     if (write_all(STDOUT_FILENO, data, len, &sinks[0].stats) < 0) {
+         perror("Error writing to standard output");
+         return -1;
+     }
+     for (int i = 1; i < num_sinks; i++) {
+         if (sinks[i].fd != -1 && sink_write(&sinks[i], data, len) < 0) {
+             drop_sink(&sinks[i]);
+         }
+     }
+     return 0;
+ }
+ 
+ /*
+  * Classic path: read into a user buffer, write it to every sink. The
+  * buffer starts at the pipe capacity (or MIN_BUFFER_SIZE) and doubles
+  * whenever a read fills it, up to MAX_BUFFER_SIZE, so a fast producer
+  * or a regular file on stdin is moved in few large syscalls while a
+  * trickling pipe does not pin memory it never uses.
+  */
+ static int copy_loop(size_t initial_size) {
+     size_t capacity = buffer_size ? buffer_size : MAX_BUFFER_SIZE;
+     size_t chunk = buffer_size ? buffer_size : initial_size;
+     char *buffer = malloc(capacity);
+     ssize_t bytes_read;
+     size_t held = 0;           /* -l: partial line at the start of buffer */
+     double held_since = 0;
+     unsigned long long reads = 0, writes = 0;
+     int status = 0;
+ 
+     if (!buffer) {
+         perror("Memory allocation error");
+         return -1;
+     }
+     if (chunk > capacity) {
+         chunk = capacity;
+     }
+ 
+     for (;;) {
+         /* Wake up while input is idle to sync files (--sync-interval),
+          * show --direct tails or flush a held partial line (-l) */
+         int timeout = input_timeout(held, held_since);
+         if (timeout >= 0) {
+             struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+             int ready = poll(&pfd, 1, timeout);
+             if (ready < 0 && errno == EINTR && !stop_signal) {
+                 continue;
+             }
+             if (ready == 0) {
+                 sync_due_sinks();
+                 if (held > 0 && line_timeout_left(held_since) == 0) {
+                     if (copy_out(buffer, held) < 0) {
+                         status = -1;
+                         break;
+                     }
+                     held = 0;
+                 }
+                 continue;
+             }
+         }
+ 
+         if (stop_signal) {
+             break;
+         }
+         size_t want = chunk < capacity - held ? chunk : capacity - held;
+         unsigned long long t = stat_begin(&input_stats);
+         bytes_read = read(STDIN_FILENO, buffer + held, want);
+         stat_end(&input_stats, t, bytes_read, 0);
+         if (bytes_read == 0) {
+             break;
+         }
+         reads++;
+         if (bytes_read < 0) {
+             if (errno == EINTR) {
+                 continue;
+             }
+             perror("Read error");
+             status = -1;
+             break;
+         }
+ 
+         size_t total = held + (size_t)bytes_read;
+         size_t out = total;
+         if (output_linebuffered) {
+             out = complete_lines(buffer, total, (size_t)bytes_read);
+             if (out == 0 && total == capacity) {
+                 out = total;    /* a line longer than the buffer */
+             }
+         }
+         if (out > 0) {
+             if (copy_out(buffer, out) < 0) {
+                 status = -1;
+                 break;
+             }
+             writes += num_sinks;
+         }
+         if (out < total) {
+             if (held == 0 || out > 0) {
+                 held_since = now_seconds();
+             }
+             memmove(buffer, buffer + out, total - out);
+         }
+         held = total - out;
+ 
+         if ((size_t)bytes_read == want && chunk < capacity) {
+             chunk = chunk * 2 < capacity ? chunk * 2 : capacity;
+             if (verbose_mode) {
+                 fprintf(stderr, "Read buffer grown to %zu bytes\n", chunk);
+             }
+         }
+     }
+ 
+     /* Input ended inside a line */
+     if (held > 0 && status == 0 && copy_out(buffer, held) < 0) {
+         status = -1;
+     }
+ 
+     if (verbose_mode) {
+         fprintf(stderr, "read/write: %llu reads, at least %llu writes\n", reads + 1, writes);
+     }
+     free(buffer);
+     return status;
+ }
+ 
+ /* Move len bytes from a pipe to the sink's descriptor. If the kernel
+  * refuses to splice into it (EINVAL, e.g. O_APPEND files or ttys), the
+  * bytes are still in the pipe, so read them out and write them instead. */
+ static int drain_pipe(struct sink *s, int pipe_fd, size_t len) {
+     char buffer[BUFFER_SIZE];
+ 
+     while (len > 0) {
+         ssize_t moved;
+ 
+         if (!s->no_splice) {
+             unsigned long long t = stat_begin(&s->stats);
+             moved = splice(pipe_fd, NULL, s->fd, NULL, len, SPLICE_F_MOVE);
+             stat_end(&s->stats, t, moved, len);
+             if (moved < 0 && errno == EINVAL) {
+                 s->no_splice = 1;
+                 if (verbose_mode) {
+                     fprintf(stderr, "%s does not accept splice(2), using write(2)\n", s->name);
+                 }
+                 continue;
+             }
+         } else {
+             moved = read(pipe_fd, buffer, len < BUFFER_SIZE ? len : BUFFER_SIZE);
+             if (moved > 0 && write_all(s->fd, buffer, moved, &s->stats) < 0) {
+                 return -1;
+             }
+         }
+         if (moved < 0) {
+             if (errno == EINTR && !stop_signal) {
+                 continue;
+             }
+             return -1;
+         }
+         len -= (size_t)moved;
+     }
+     return 0;
+ }
+ 
+ /*
+  * Zero-copy path for a pipe on stdin. Each round tee(2) duplicates what
+  * is buffered in stdin into every file's (empty) relay pipe without
+  * consuming it, then the same bytes are spliced from stdin straight to
+  * standard output, which consumes them, and finally each relay is
+  * spliced into its file. Data only ever moves as page references.
+  *
+  * tee(2) cannot resume a partial duplication, so if a relay takes fewer
+  * bytes than the first one did, the round consumes stdin with read(2)
+  * instead and the missing tail is written from that buffer.
+  */
+ static int splice_loop(size_t pipe_size) {
+     char *buffer = malloc(pipe_size);
+     size_t *teed = calloc(num_sinks, sizeof(size_t));
+     int status = 0;
+ 
+     if (!buffer || !teed) {
+         perror("Memory allocation error");
+         free(buffer);
+         free(teed);
+         return -1;
+     }
+ 
+     while (!stop_signal) {
+         size_t round = 0;
+         size_t left;
+         int short_tee = 0;
+         int have_relays = 0;
+ 
+         /* Duplicate into every file's relay */
+         for (int i = 1; i < num_sinks; i++) {
+             ssize_t n;
+ 
+             if (sinks[i].fd == -1) {
+                 continue;
+             }
+             do {
+                 /* The first tee(2) of a round is where stdin is waited on */
+                 unsigned long long t = have_relays ? 0 : stat_begin(&input_stats);
+                 n = tee(STDIN_FILENO, sinks[i].relay[1], have_relays ? round : pipe_size, 0);
+                 stat_end(&input_stats, t, n, 0);
+             } while (n < 0 && errno == EINTR && (have_relays || !stop_signal));
+             if (n < 0) {
+                 if (!have_relays && stop_signal) {
+                     goto out;
+                 }
+                 perror("tee(2) error");
+                 status = -1;
+                 goto out;
+             }
+             if (!have_relays) {
+                 if (n == 0) {
+                     goto out;  /* EOF */
+                 }
+                 round = (size_t)n;
+                 have_relays = 1;
+             } else if ((size_t)n < round) {
+                 short_tee = 1;
+             }
+             teed[i] = (size_t)n;
+         }
+ 
+         /* Consume the round into standard output */
+         left = have_relays ? round : pipe_size;
+         while (!short_tee && !sinks[0].no_splice && left > 0) {
+             unsigned long long t = stat_begin(&sinks[0].stats);
+             ssize_t n = splice(STDIN_FILENO, NULL, STDOUT_FILENO, NULL, left, SPLICE_F_MOVE);
+             stat_end(&sinks[0].stats, t, n, left);
+             if (!have_relays && n > 0) {
+                 stat_add(&input_stats.bytes, (unsigned long long)n);   /* no tee(2) ran */
+                 stat_add(&input_stats.calls, 1);
+             }
+             if (n < 0) {
+                 if (errno == EINTR) {
+                     if (!stop_signal) {
+                         continue;
+                     }
+                     if (have_relays) {
+                         /* Standard output is stuck; the round is lost */
+                         perror("Error writing to standard output");
+                         status = -1;
+                     }
+                     goto out;
+                 }
+                 if (errno == EINVAL) {
+                     /* Rejected before anything moved; finish with read(2) */
+                     sinks[0].no_splice = 1;
+                     if (verbose_mode) {
+                         fprintf(stderr, "standard output does not accept splice(2), using write(2)\n");
+                     }
+                     break;
+                 }
+                 perror("Error writing to standard output");
+                 status = -1;
+                 goto out;
+             }
+             if (!have_relays) {
+                 if (n == 0) {
+                     goto out;  /* EOF */
+                 }
+                 round = (size_t)n;
+                 left = 0;
+             } else {
+                 left -= (size_t)n;
+             }
+         }
+         if (left > 0) {
+             /* Read what is left of the round; without relays, whatever is there */
+             char *start = buffer + (have_relays ? round - left : 0);
+             size_t got = 0;
+             while (got < left) {
+                 unsigned long long t = stat_begin(&input_stats);
+                 ssize_t n = read(STDIN_FILENO, start + got, left - got);
+                 stat_end(&input_stats, t, have_relays ? 0 : n, 0);   /* teed bytes counted */
+                 if (n < 0) {
+                     if (errno == EINTR) {
+                         if (!have_relays && stop_signal) {
+                             goto out;
+                         }
+                         continue;
+                     }
+                     perror("Read error");
+                     status = -1;
+                     goto out;
+                 }
+                 got += (size_t)n;
+                 if (n == 0 || !have_relays) {
+                     break;
+                 }
+             }
+             if (!have_relays) {
+                 if (got == 0) {
+                     goto out;  /* EOF */
+                 }
+                 round = got;
+             }
+             if (write_all(STDOUT_FILENO, start, got, &sinks[0].stats) < 0) {
+                 perror("Error writing to standard output");
+                 status = -1;
+                 goto out;
+             }
+         }
+ 
+         /* Empty every relay into its file, then add any missing tail */
+         for (int i = 1; i < num_sinks; i++) {
+             if (sinks[i].fd == -1) {
+                 continue;
+             }
+             if (drain_pipe(&sinks[i], sinks[i].relay[0], teed[i]) < 0 ||
+                 (teed[i] < round && write_all(sinks[i].fd, buffer + teed[i], round - teed[i],
+                                               &sinks[i].stats) < 0)) {
+                 drop_sink(&sinks[i]);
+             }
+             teed[i] = 0;
+         }
+     }
+ 
+ out:
+     free(buffer);
+     free(teed);
+     return status;
+ }
+ 
+ /*
+  * Threaded path (-t): the main thread only reads. Each block of input
+  * goes into a reference-counted chunk from a shared pool, and a pointer
+  * to it is pushed onto every sink's bounded single-producer/single-
+  * consumer queue. Each sink has its own writer thread, so a slow file
+  * only ever delays itself: when its queue is full the lag policy decides
+  * whether the reader waits for it, skips it for that chunk, or detaches
+  * it for good. The last writer to finish with a chunk hands it back to
+  * the pool. Queues and the pool are lock-free; threads park on futexes
+  * only when there is nothing to do.
+  */
+ 
+ /* Sleep while *addr == expected; -1 with ETIMEDOUT if timeout_ms (when
+  * not negative) ran out first */
+ static int futex_wait(atomic_uint *addr, unsigned int expected, int timeout_ms) {
+     struct timespec timeout;
+ 
+     timeout.tv_sec = timeout_ms / 1000;
+     timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+     return (int)syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected,
+                         timeout_ms >= 0 ? &timeout : NULL, NULL, 0);
+ }
+ 
+ static void futex_wake(atomic_uint *addr) {
+     syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+ }
+ 
+ static struct chunk *pool = NULL;
+ static int pool_size = 0;
+ static int pool_next = 0;
+ static atomic_uint pool_released;   /* bumped whenever a chunk is freed */
+ static atomic_int pool_waiting;
+ static atomic_int abort_copy;       /* standard output failed: stop reading */
+ 
+ /* Take a free chunk from the pool (reader thread only) */
+ static struct chunk *acquire_chunk(size_t chunk_size) {
+     for (;;) {
+         unsigned int seen;
+ 
+         for (int pass = 0; pass < 2; pass++) {
+             for (int i = 0; i < pool_size; i++) {
+                 struct chunk *c = &pool[(pool_next + i) % pool_size];
+                 if (atomic_load(&c->refs) == 0) {
+                     pool_next = (pool_next + i + 1) % pool_size;
+                     if (!c->data && !(c->data = malloc(chunk_size))) {
+                         return NULL;
+                     }
+                     return c;
+                 }
+             }
+             /* Announce the wait, then scan once more before sleeping */
+             seen = atomic_load(&pool_released);
+             atomic_store(&pool_waiting, 1);
+         }
+         futex_wait(&pool_released, seen, -1);
+         atomic_store(&pool_waiting, 0);
+     }
+ }
+ 
+ static void release_chunk(struct chunk *c) {
+     if (atomic_fetch_sub(&c->refs, 1) == 1) {
+         atomic_fetch_add(&pool_released, 1);
+         if (atomic_load(&pool_waiting)) {
+             futex_wake(&pool_released);
+         }
+     }
+ }
+ 
+ static int queue_full(struct sink_queue *q) {
+     return atomic_load(&q->head) - atomic_load(&q->tail) > q->mask;
+ }
+ 
+ static void queue_push(struct sink_queue *q, struct chunk *c) {
+     unsigned int head = atomic_load(&q->head);
+     q->slots[head & q->mask] = c;
+     atomic_store(&q->head, head + 1);
+     if (atomic_load(&q->consumer_waiting)) {
+         futex_wake(&q->head);
+     }
+ }
+ 
+ /* Wait for room in a full queue (reader thread, block policy); -1 if,
+  * after a stop signal, the writer made no progress for STOP_WAIT_MS */
+ static int queue_wait_space(struct sink_queue *q) {
+     while (queue_full(q)) {
+         unsigned int tail = atomic_load(&q->tail);
+         int rc = 0;
+ 
+         atomic_store(&q->producer_waiting, 1);
+         if (queue_full(q)) {
+             rc = futex_wait(&q->tail, tail, stop_signal ? STOP_WAIT_MS : -1);
+         }
+         atomic_store(&q->producer_waiting, 0);
+         if (rc < 0 && errno == ETIMEDOUT && atomic_load(&q->tail) == tail) {
+             return -1;
+         }
+     }
+     return 0;
+ }
+ 
+ /* Next chunk for a writer thread; NULL once the queue is closed and
+  * empty, or with *timed_out set if timeout_ms passed with nothing new */
+ static struct chunk *queue_pop(struct sink_queue *q, int timeout_ms, int *timed_out) {
+     unsigned int tail = atomic_load(&q->tail);
+     struct chunk *c;
+ 
+     *timed_out = 0;
+     while (atomic_load(&q->head) == tail) {
+         if (atomic_load(&q->closed)) {
+             if (atomic_load(&q->head) == tail) {
+                 return NULL;
+             }
+             break;
+         }
+         atomic_store(&q->consumer_waiting, 1);
+         if (atomic_load(&q->head) == tail && !atomic_load(&q->closed) &&
+             futex_wait(&q->head, tail, timeout_ms) < 0 && errno == ETIMEDOUT) {
+             atomic_store(&q->consumer_waiting, 0);
+             if (atomic_load(&q->head) == tail) {
+                 *timed_out = 1;
+                 return NULL;
+             }
+         }
+         atomic_store(&q->consumer_waiting, 0);
+     }
+ 
+     c = q->slots[tail & q->mask];
+     atomic_store(&q->tail, tail + 1);
+     if (atomic_load(&q->producer_waiting)) {
+         futex_wake(&q->tail);
+     }
+     return c;
+ }
  
- /* Help information */
- static void print_help(void) {
-     printf("Usage: tee [OPTION]... [FILE]...\n");
-     printf("Read from standard input and write to both standard output and files.\n\n");
-     printf("  -a, --append              append to the given FILEs, do not overwrite\n");
-     printf("  -i, --ignore-interrupts   ignore interrupt signals\n");
-     printf("  -l, --line-buffered       use line buffering for output\n");
-     printf("  -v, --verbose             print diagnostic messages\n");
-     printf("      --help                display this help and exit\n");
-     printf("      --version             output version information and exit\n");
-     printf("\nPart of %s package, version %s\n", PACKAGE, VERSION);
-     printf("Author: AnmiTaliDev\n");
-     printf("License: Apache 2.0\n");
+ static void queue_close(struct sink_queue *q) {
+     atomic_store(&q->closed, 1);
+     futex_wake(&q->head);
  }
  
- /* Version information */
- static void print_version(void) {
-     printf("tee (QCO MoreUtils) %s\n", VERSION);
-     printf("Copyright (C) 2025 AnmiTaliDev\n");
-     printf("License: Apache 2.0\n");
+ static void *sink_writer(void *arg) {
+     struct sink *s = arg;
+     struct chunk *c;
+     double start = now_seconds();
+     int timed_out;
+ 
+     for (;;) {
+         c = queue_pop(&s->queue, s == &sinks[0] ? -1 : idle_timeout(s, now_seconds()), &timed_out);
+         if (!c) {
+             if (!timed_out) {
+                 break;
+             }
+             /* Idle past --sync-interval or DIRECT_TAIL_MS */
+             if (atomic_load(&s->attached) && idle_flush(s, now_seconds()) < 0) {
+                 fprintf(stderr, "tee: %s: %s\n", s->name, strerror(errno));
+                 atomic_store(&s->attached, 0);
+                 atomic_store(&output_failed, 1);
+             }
+             continue;
+         }
+ 
+         if (atomic_load(&s->attached)) {
+             int rc = s == &sinks[0] ? write_all(s->fd, c->data, c->len, &s->stats)
+                                     : sink_write(s, c->data, c->len);
+             if (rc == 0) {
+                 s->bytes_written += c->len;
+             } else if (s == &sinks[0]) {
+                 perror("Error writing to standard output");
+                 atomic_store(&s->attached, 0);
+                 atomic_store(&abort_copy, 1);
+                 atomic_store(&output_failed, 1);
+             } else {
+                 fprintf(stderr, "tee: %s: %s\n", s->name, strerror(errno));
+                 atomic_store(&s->attached, 0);
+                 atomic_store(&output_failed, 1);
+             }
+         }
+         release_chunk(c);
+     }
+     s->seconds = now_seconds() - start;
+     return NULL;
  }
  
- /* Signal handler */
- static void signal_handler(int sig) {
+ /* Queue a chunk for one sink, applying its lag policy if the queue is full */
+ static void dispatch(struct sink *s, struct chunk *c, enum lag_policy policy) {
+     unsigned int depth;
+ 
+     if (queue_full(&s->queue)) {
+         if (policy == LAG_DROP) {
+             s->bytes_dropped += c->len;
+             return;
+         }
+         if (policy == LAG_DETACH) {
+             /* The writer still finishes what is already queued */
+             s->detached = 1;
+             queue_close(&s->queue);
+             if (verbose_mode) {
+                 fprintf(stderr, "tee: %s: detached, more than %u chunks behind\n",
+                         s->name, s->queue.mask + 1);
+             }
+             return;
+         }
+         if (queue_wait_space(&s->queue) < 0) {
+             return;     /* stopping: the reader reads no more */
+         }
+     }
+ 
+     atomic_fetch_add(&c->refs, 1);
+     queue_push(&s->queue, c);
+     depth = atomic_load(&s->queue.head) - atomic_load(&s->queue.tail);
+     if (depth > s->max_lag) {
+         s->max_lag = depth;
+     }
+ }
+ 
+ /* Hand a chunk to every attached writer */
+ static void broadcast_chunk(struct chunk *c) {
+     /* Hold a reference while handing the chunk out */
+     atomic_store(&c->refs, 1);
+     for (int i = 0; i < num_sinks; i++) {
+         if (sinks[i].has_thread && !sinks[i].detached && atomic_load(&sinks[i].attached)) {
+             /* Standard output always keeps up with the input */
+             dispatch(&sinks[i], c, i == 0 ? LAG_BLOCK : lag_policy);
+         }
+     }
+     release_chunk(c);
+ }
+ 
+ /* Wait for a writer thread to finish its queue. After a stop signal it
+  * may be blocked writing to an output nobody reads, so it is interrupted
+  * every STOP_WAIT_MS until it gives up on that output. */
+ static void join_writer(struct sink *s) {
+     static int wake_installed = 0;
+ 
+     for (;;) {
+         struct timespec deadline;
+ 
+         clock_gettime(CLOCK_REALTIME, &deadline);
+         deadline.tv_nsec += STOP_WAIT_MS * 1000000L;
+         if (deadline.tv_nsec >= 1000000000L) {
+             deadline.tv_sec++;
+             deadline.tv_nsec -= 1000000000L;
+         }
+         if (pthread_timedjoin_np(s->thread, NULL, &deadline) == 0) {
+             return;
+         }
+         if (stop_signal) {
+             if (!wake_installed) {
+                 struct sigaction wake_action;
+                 memset(&wake_action, 0, sizeof(wake_action));
+                 wake_action.sa_handler = wake_handler;
+                 sigemptyset(&wake_action.sa_mask);
+                 sigaction(WAKE_SIGNAL, &wake_action, NULL);
+                 wake_installed = 1;
+             }
+             pthread_kill(s->thread, WAKE_SIGNAL);
+         }
+     }
+ }
+ 
+ static int threaded_loop(size_t chunk_size) {
+     unsigned int slots = 1;
+     int started = 0;
+     int status = 0;
+     char *tail = NULL;        /* -l: partial line carried into the next chunk */
+     size_t held = 0;
+     double held_since = 0;
+ 
+     while (slots < ring_size) {
+         slots <<= 1;
+     }
+ 
+     /* Enough chunks that every queue can be full at once */
+     pool_size = num_sinks * (slots + 1) + 1;
+     pool = calloc(pool_size, sizeof(struct chunk));
+     if (!pool) {
+         perror("Memory allocation error");
+         return -1;
+     }
+ 
+     for (int i = 0; i < num_sinks; i++) {
+         struct sink *s = &sinks[i];
+         if (s->fd == -1) {
+             continue;
+         }
+         s->queue.slots = calloc(slots, sizeof(struct chunk *));
+         s->queue.mask = slots - 1;
+         atomic_store(&s->attached, 1);
+         if (!s->queue.slots || start_thread(&s->thread, sink_writer, s) != 0) {
+             fprintf(stderr, "tee: %s: cannot start writer thread\n", s->name);
+             atomic_store(&s->attached, 0);
+             continue;
+         }
+         s->has_thread = 1;
+         started++;
+     }
+     if (verbose_mode) {
+         fprintf(stderr, "Using threaded path (%d writers, %u x %zu byte chunks each, lag policy %s)\n",
+                 started, slots, chunk_size, lag_policy_names[lag_policy]);
+     }
+ 
+     if (output_linebuffered && !(tail = malloc(chunk_size))) {
+         perror("Memory allocation error");
+         status = -1;
+     }
+ 
+     while (status == 0 && !atomic_load(&abort_copy)) {
+         struct chunk *c;
+         ssize_t n;
+ 
+         /* -l: a partial line that waited long enough goes out alone */
+         if (held > 0) {
+             int timeout = line_timeout_left(held_since);
+             struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+             if (timeout == 0 || poll(&pfd, 1, timeout) == 0) {
+                 if (!(c = acquire_chunk(chunk_size))) {
+                     perror("Memory allocation error");
+                     status = -1;
+                     break;
+                 }
+                 memcpy(c->data, tail, held);
+                 c->len = held;
+                 held = 0;
+                 broadcast_chunk(c);
+                 continue;
+             }
+         }
+ 
+         c = acquire_chunk(chunk_size);
+         if (!c) {
+             perror("Memory allocation error");
+             status = -1;
+             break;
+         }
+         memcpy(c->data, tail, held);
+         n = 0;
+         while (!stop_signal) {
+             unsigned long long t = stat_begin(&input_stats);
+             n = read(STDIN_FILENO, c->data + held, chunk_size - held);
+             stat_end(&input_stats, t, n, 0);
+             if (n >= 0 || errno != EINTR) {
+                 break;
+             }
+             n = 0;      /* a stop signal ends the input */
+         }
+         if (n <= 0) {
+             if (n < 0) {
+                 perror("Read error");
+                 status = -1;
+             } else if (held > 0) {
+                 c->len = held;    /* input ended inside a line */
+                 broadcast_chunk(c);
+             }
+             break;
+         }
+ 
+         size_t total = held + (size_t)n;
+         c->len = total;
+         if (output_linebuffered) {
+             c->len = complete_lines(c->data, total, (size_t)n);
+             if (c->len == 0 && total == chunk_size) {
+                 c->len = total;   /* a line longer than a chunk */
+             }
+             if (c->len < total) {
+                 if (held == 0 || c->len > 0) {
+                     held_since = now_seconds();
+                 }
+                 memcpy(tail, c->data + c->len, total - c->len);
+             }
+             held = total - c->len;
+         }
+         if (c->len > 0) {
+             broadcast_chunk(c);
+         }
+     }
+     free(tail);
+ 
+     for (int i = 0; i < num_sinks; i++) {
+         if (sinks[i].has_thread) {
+             queue_close(&sinks[i].queue);
+         }
+     }
+     for (int i = 0; i < num_sinks; i++) {
+         struct sink *s = &sinks[i];
+         if (!s->has_thread) {
+             continue;
+         }
+         join_writer(s);
+         if (s != &sinks[0] && !atomic_load(&s->attached)) {
+             /* Its writer gave up on it and said why; leave it as it is */
+             close(s->fd);
+             s->fd = -1;
+         }
+         if (verbose_mode) {
+             fprintf(stderr, "tee: %s: %llu bytes, %.1f MB/s, max lag %u/%u chunks",
+                     s->name, s->bytes_written,
+                     s->seconds > 0 ? s->bytes_written / s->seconds / 1e6 : 0.0,
+                     s->max_lag, slots);
+             if (s->bytes_dropped) {
+                 fprintf(stderr, ", dropped %llu bytes", s->bytes_dropped);
+             }
+             fprintf(stderr, "%s\n", s->detached ? ", detached" : "");
+         }
+         free(s->queue.slots);
+     }
+ 
+     for (int i = 0; i < pool_size; i++) {
+         free(pool[i].data);
+     }
+     free(pool);
+     return status;
+ }
+ 
+ /*
+  * io_uring path (--io-uring): per chunk, one io_uring_enter(2) submits
+  * a write SQE for every output plus the read of the next chunk into the
+  * other buffer, then reaps all their completions. Buffers and
+  * descriptors are registered with the ring when the kernel allows it.
+  * A sink has at most one write in flight, so writes to pipes and ttys
+  * stay ordered; short writes are resubmitted for the remainder.
+  */
+ #define URING_READ_TAG ((__u64)-1)
+ 
+ static void uring_prep_rw(struct io_uring_sqe *sqe, int op, int fixed_op, int file,
+                           int use_fixed_file, char *buf, size_t len, int buf_index) {
+     sqe->opcode = buf_index >= 0 ? fixed_op : op;
+     sqe->fd = file;
+     sqe->flags = use_fixed_file ? IOSQE_FIXED_FILE : 0;
+     sqe->addr = (unsigned long)buf;
+     sqe->len = (unsigned int)len;
+     sqe->off = (__u64)-1;   /* current file position */
+     if (buf_index >= 0) {
+         sqe->buf_index = (__u16)buf_index;
+     }
+ }
+ 
+ /* Returns 1 if the ring ran to EOF, 0 if io_uring is unavailable and
+  * nothing was read yet, -1 on error */
+ static int uring_loop(size_t chunk_size) {
+     struct uring ring;
+     struct iovec iov[2];
+     char *buffers[2] = { NULL, NULL };
+     static const unsigned char ops[] = {
+         IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED
+     };
+     int *files = NULL;        /* registered slot (or raw fd) per sink, stdin last */
+     size_t *done = NULL;      /* bytes of the current chunk written per sink */
+     unsigned int entries = 4;
+     int fixed_files = 0, fixed_buffers = 0;
+     unsigned long long chunks = 0, enters = 0, sqes = 0;
+     size_t len;
+     int cur = 0;
+     int status = 1;
+ 
+     while (entries < (unsigned int)num_sinks * 2 + 2) {
+         entries <<= 1;
+     }
+     if (uring_init(&ring, entries) < 0) {
+         if (verbose_mode) {
+             fprintf(stderr, "io_uring unavailable (%s), falling back\n", strerror(errno));
+         }
+         return 0;
+     }
+     if (uring_probe(&ring, ops, sizeof(ops)) < 0) {
+         if (verbose_mode) {
+             fprintf(stderr, "io_uring cannot read and write (%s), falling back\n", strerror(errno));
+         }
+         uring_exit(&ring);
+         return 0;
+     }
+ 
+     files = malloc((num_sinks + 1) * sizeof(int));
+     done = calloc(num_sinks, sizeof(size_t));
+     for (int i = 0; i < 2; i++) {
+         void *p = NULL;
+         if (posix_memalign(&p, 4096, chunk_size) == 0) {
+             buffers[i] = p;
+         }
+     }
+     if (!files || !done || !buffers[0] || !buffers[1]) {
+         perror("Memory allocation error");
+         status = -1;
+         goto out;
+     }
+ 
+     /* Register descriptors and buffers; plain ones work too, just slower */
+     for (int i = 0; i < num_sinks; i++) {
+         files[i] = sinks[i].fd;
+     }
+     files[num_sinks] = STDIN_FILENO;
+     if (uring_register(&ring, IORING_REGISTER_FILES, files, num_sinks + 1) == 0) {
+         fixed_files = 1;
+         for (int i = 0; i <= num_sinks; i++) {
+             files[i] = i;
+         }
+     }
+     for (int i = 0; i < 2; i++) {
+         iov[i].iov_base = buffers[i];
+         iov[i].iov_len = chunk_size;
+     }
+     fixed_buffers = uring_register(&ring, IORING_REGISTER_BUFFERS, iov, 2) == 0;
+     if (verbose_mode) {
+         fprintf(stderr, "Using io_uring path (%u entries, %zu byte chunks, registered files: %s, buffers: %s)\n",
+                 entries, chunk_size, fixed_files ? "yes" : "no", fixed_buffers ? "yes" : "no");
+     }
+ 
+     /* First chunk */
+     for (len = 0; !stop_signal;) {
+         unsigned long long t = stat_begin(&input_stats);
+         ssize_t n = read(STDIN_FILENO, buffers[cur], chunk_size);
+         stat_end(&input_stats, t, n, 0);
+         if (n >= 0) {
+             len = (size_t)n;
+             break;
+         }
+         if (errno != EINTR) {
+             perror("Read error");
+             status = -1;
+             goto out;
+         }
+     }
+ 
+     while (len > 0) {
+         unsigned int pending = 0;
+         size_t next_len = 0;
+         int reading = 1;
+         struct io_uring_sqe *sqe;
+ 
+         /* Writes of this chunk to every sink, plus the next read */
+         for (int i = 0; i < num_sinks; i++) {
+             if (sinks[i].fd == -1) {
+                 continue;
+             }
+             done[i] = 0;
+             sqe = uring_get_sqe(&ring);
+             uring_prep_rw(sqe, IORING_OP_WRITE, IORING_OP_WRITE_FIXED, files[i], fixed_files,
+                           buffers[cur], len, fixed_buffers ? cur : -1);
+             sqe->user_data = (__u64)i;
+             pending++;
+         }
+         sqe = uring_get_sqe(&ring);
+         uring_prep_rw(sqe, IORING_OP_READ, IORING_OP_READ_FIXED, files[num_sinks], fixed_files,
+                       buffers[cur ^ 1], chunk_size, fixed_buffers ? (cur ^ 1) : -1);
+         sqe->user_data = URING_READ_TAG;
+         sqes += pending + 1;
+ 
+         /* With --stats each completion is timed from its batch's submission */
+         unsigned long long submitted = stat_begin(&input_stats);
+         for (int i = 0; submitted && i < num_sinks; i++) {
+             if (sinks[i].fd != -1) {
+                 atomic_store_explicit(&sinks[i].stats.busy_since, submitted, memory_order_relaxed);
+             }
+         }
+ 
+         while (pending > 0 || reading) {
+             struct io_uring_cqe *cqe;
+ 
+             /* Stopped: leave the read in flight, uring_exit() cancels it,
+              * and give up on outputs whose writes are stuck */
+             if (stop_signal) {
+                 struct pollfd pfd = { ring.fd, POLLIN, 0 };
+ 
+                 if (pending == 0) {
+                     next_len = 0;
+                     break;
+                 }
+                 if (uring_enter(&ring, 0) < 0 && errno != EINTR) {
+                     perror("io_uring_enter");
+                     status = -1;
+                     goto out;
+                 }
+                 if (!uring_peek_cqe(&ring) && poll(&pfd, 1, STOP_WAIT_MS) <= 0) {
+                     for (int i = 0; i < num_sinks; i++) {
+                         if (sinks[i].fd == -1 || done[i] >= len) {
+                             continue;
+                         }
+                         errno = EINTR;
+                         if (i == 0) {
+                             perror("Error writing to standard output");
+                             status = -1;
+                         } else {
+                             drop_sink(&sinks[i]);
+                         }
+                     }
+                     goto out;
+                 }
+             } else if (uring_enter(&ring, pending + reading) < 0) {
+                 if (errno == EINTR) {
+                     continue;
+                 }
+                 perror("io_uring_enter");
+                 status = -1;
+                 goto out;
+             }
+             enters++;
+ 
+             while ((cqe = uring_peek_cqe(&ring)) != NULL) {
+                 __u64 tag = cqe->user_data;
+                 int res = cqe->res;
+                 uring_cqe_seen(&ring);
+                 if (res < 0) {
+                     errno = -res;   /* for stat_end and the error messages below */
+                 }
+ 
+                 if (tag == URING_READ_TAG) {
+                     stat_end(&input_stats, submitted, res, 0);
+                     if (res == -EINTR || res == -EAGAIN) {
+                         sqe = uring_get_sqe(&ring);
+                         uring_prep_rw(sqe, IORING_OP_READ, IORING_OP_READ_FIXED, files[num_sinks],
+                                       fixed_files, buffers[cur ^ 1], chunk_size,
+                                       fixed_buffers ? (cur ^ 1) : -1);
+                         sqe->user_data = URING_READ_TAG;
+                         sqes++;
+                         continue;
+                     }
+                     if (res < 0) {
+                         perror("Read error");
+                         status = -1;
+                         next_len = 0;
+                     } else {
+                         next_len = (size_t)res;
+                     }
+                     reading = 0;
+                     continue;
+                 }
+ 
+                 struct sink *s = &sinks[tag];
+                 stat_end(&s->stats, submitted, res, len - done[tag]);
+                 if (res == -EINTR || res == -EAGAIN) {
+                     res = 0;
+                 } else if (res < 0) {
+                     if (tag == 0) {
+                         perror("Error writing to standard output");
+                         status = -1;
+                         goto out;
+                     }
+                     drop_sink(s);
+                     pending--;
+                     continue;
+                 }
+                 done[tag] += (size_t)res;
+                 if (done[tag] < len) {
+                     /* Short write: resubmit the rest of the chunk */
+                     sqe = uring_get_sqe(&ring);
+                     uring_prep_rw(sqe, IORING_OP_WRITE, IORING_OP_WRITE_FIXED, files[tag], fixed_files,
+                                   buffers[cur] + done[tag], len - done[tag], fixed_buffers ? cur : -1);
+                     sqe->user_data = tag;
+                     sqes++;
+                 } else {
+                     pending--;
+                 }
+             }
+         }
+ 
+         chunks++;
+         cur ^= 1;
+         len = next_len;
+     }
+ 
      if (verbose_mode) {
-         fprintf(stderr, "Received signal %d\n", sig);
+         fprintf(stderr, "io_uring: %llu chunks, %llu SQEs in %llu io_uring_enter calls\n",
+                 chunks, sqes, enters);
+     }
+ 
+ out:
+     uring_exit(&ring);
+     free(buffers[0]);
+     free(buffers[1]);
+     free(files);
+     free(done);
+     return status;
+ }
+ 
+ /*
+  * --stats output: one JSON object per line, written on SIGUSR1 and at
+  * exit. "blocked_seconds" is how long the call in progress on that side
+  * has been waiting, which shows at a glance whether a stalled pipeline
+  * is held up by its input or by one of the outputs.
+  */
+ static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+ static unsigned long long stats_start;
+ 
+ static void json_string(FILE *f, const char *text) {
+     fputc('"', f);
+     for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+         if (*p == '"' || *p == '\\') {
+             fprintf(f, "\\%c", *p);
+         } else if (*p < 0x20) {
+             fprintf(f, "\\u%04x", *p);
+         } else {
+             fputc(*p, f);
+         }
+     }
+     fputc('"', f);
+ }
+ 
+ static void json_io_stats(FILE *f, struct io_stats *st, int is_output, unsigned long long now) {
+     unsigned long long busy = atomic_load_explicit(&st->busy_since, memory_order_relaxed);
+ 
+     fprintf(f, "\"bytes\":%llu,\"%s\":%llu,\"wait_seconds\":%.6f,\"blocked_seconds\":%.6f,",
+             atomic_load_explicit(&st->bytes, memory_order_relaxed), is_output ? "writes" : "reads",
+             atomic_load_explicit(&st->calls, memory_order_relaxed),
+             atomic_load_explicit(&st->wait_ns, memory_order_relaxed) / 1e9,
+             busy && now > busy ? (now - busy) / 1e9 : 0.0);
+     if (is_output) {
+         fprintf(f, "\"short_writes\":%llu,",
+                 atomic_load_explicit(&st->short_calls, memory_order_relaxed));
+     }
+     fprintf(f, "\"retries\":%llu", atomic_load_explicit(&st->retries, memory_order_relaxed));
+ }
+ 
+ static void stats_dump(const char *event) {
+     unsigned long long now = now_ns();
+     char *line = NULL;
+     size_t len = 0;
+     FILE *f;
+ 
+     pthread_mutex_lock(&stats_lock);
+     f = open_memstream(&line, &len);
+     if (!f) {
+         pthread_mutex_unlock(&stats_lock);
+         return;
+     }
+     fprintf(f, "{\"event\":\"%s\",\"pid\":%d,\"elapsed_seconds\":%.6f,\"engine\":\"%s\",\"input\":{",
+             event, (int)getpid(), (now - stats_start) / 1e9, engine_name);
+     json_io_stats(f, &input_stats, 0, now);
+     fprintf(f, "},\"sinks\":[");
+     for (int i = 0; i < num_sinks; i++) {
+         fprintf(f, "%s{\"name\":", i ? "," : "");
+         json_string(f, sinks[i].name);
+         fprintf(f, ",");
+         json_io_stats(f, &sinks[i].stats, 1, now);
+         fprintf(f, ",\"dropped_bytes\":%llu,\"open\":%s}", sinks[i].bytes_dropped,
+                 sinks[i].fd != -1 && (!sinks[i].has_thread || atomic_load(&sinks[i].attached))
+                     ? "true" : "false");
+     }
+     fprintf(f, "]}\n");
+     if (fclose(f) == 0) {
+         write_all(stats_fd, line, len, NULL);
+     }
+     free(line);
+     pthread_mutex_unlock(&stats_lock);
+ }
+ 
+ /* SIGUSR1 is blocked in every thread and taken here with sigwait(), so a
+  * snapshot never interrupts a syscall on the copy path */
+ static void *stats_signal_thread(void *arg) {
+     sigset_t *set = arg;
+     int sig;
+ 
+     for (;;) {
+         if (sigwait(set, &sig) == 0) {
+             stats_dump("signal");
+         }
+     }
+     return NULL;
+ }
+ 
+ static int stats_setup(const char *path) {
+     static sigset_t set;
+     pthread_t thread;
+ 
+     if (path) {
+         stats_fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+         if (stats_fd < 0) {
+             return -1;
+         }
+     }
+     stats_start = now_ns();
+     sigemptyset(&set);
+     sigaddset(&set, SIGUSR1);
+     if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0 ||
+         start_thread(&thread, stats_signal_thread, &set) != 0) {
+         return -1;
+     }
+     pthread_detach(thread);
+     return 0;
+ }
+ 
+ /* Capacity of the stdin pipe, raised first if -p asked for it; 0 if
+  * stdin is not a pipe */
+ static size_t stdin_pipe_size(void) {
+     struct stat st;
+     int size;
+ 
+     if (fstat(STDIN_FILENO, &st) < 0 || !S_ISFIFO(st.st_mode)) {
+         return 0;
+     }
+     if (pipe_size_request > 0 &&
+         fcntl(STDIN_FILENO, F_SETPIPE_SZ, (int)pipe_size_request) < 0 && verbose_mode) {
+         fprintf(stderr, "Cannot resize input pipe to %zu bytes: %s\n",
+                 pipe_size_request, strerror(errno));
+     }
+     size = fcntl(STDIN_FILENO, F_GETPIPE_SZ);
+     return size > 0 ? (size_t)size : 0;
+ }
+ 
+ /* Give every file a relay pipe able to take everything buffered in stdin */
+ static int setup_splice(size_t pipe_size) {
+     for (int i = 1; i < num_sinks; i++) {
+         if (sinks[i].fd == -1) {
+             continue;
+         }
+         if (pipe(sinks[i].relay) < 0 ||
+             fcntl(sinks[i].relay[1], F_SETPIPE_SZ, (int)pipe_size) < (int)pipe_size) {
+             return -1;
+         }
      }
-     exit(EXIT_SUCCESS);
+     return 0;
  }
  
  int main(int argc, char *argv[]) {
-     char buffer[BUFFER_SIZE];
-     size_t bytes_read;
-     int *file_descriptors = NULL;
-     int num_files = 0;
      int option;
+     size_t pipe_size;
+     size_t chunk_size;
+     int status;
+     const char *stats_path = NULL;
+     struct sigaction stop_action;
+     char *end;
      
      /* Command line options */
      static struct option long_options[] = {
@@ -80,13 +2108,30 @@
          {"ignore-interrupts", no_argument, NULL, 'i'},
          {"line-buffered", no_argument, NULL, 'l'},
          {"verbose", no_argument, NULL, 'v'},
+         {"buffer-size", required_argument, NULL, 'b'},
+         {"pipe-size", required_argument, NULL, 'p'},
+         {"threads", no_argument, NULL, 't'},
+         {"lag-policy", required_argument, NULL, 'L'},
+         {"ring-size", required_argument, NULL, 'R'},
+         {"io-uring", no_argument, NULL, 'U'},
+         {"sync-bytes", required_argument, NULL, 'S'},
+         {"sync-interval", required_argument, NULL, 'I'},
+         {"direct", no_argument, NULL, 'D'},
+         {"compress", no_argument, NULL, 'z'},
+         {"compress-level", required_argument, NULL, 'C'},
+         {"rotate-bytes", required_argument, NULL, 'B'},
+         {"rotate-seconds", required_argument, NULL, 'T'},
+         {"rotate-name", required_argument, NULL, 'N'},
+         {"rotate-lines", no_argument, NULL, 'W'},
+         {"stats", optional_argument, NULL, 'X'},
+         {"line-timeout", required_argument, NULL, 'O'},
          {"help", no_argument, NULL, 'h'},
          {"version", no_argument, NULL, 'V'},
          {NULL, 0, NULL, 0}
      };
  
      /* Parse command line options */
-     while ((option = getopt_long(argc, argv, "ailv", long_options, NULL)) != -1) {
+     while ((option = getopt_long(argc, argv, "ailvb:p:tz", long_options, NULL)) != -1) {
          switch (option) {
              case 'a':
                  append_flag = 1;
@@ -100,6 +2145,104 @@
              case 'v':
                  verbose_mode = 1;
                  break;
+             case 'b':
+                 buffer_size = parse_size(optarg);
+                 if (buffer_size == 0) {
+                     fprintf(stderr, "tee: invalid buffer size: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 break;
+             case 'p':
+                 pipe_size_request = parse_size(optarg);
+                 if (pipe_size_request == 0 || pipe_size_request > 0x7fffffff) {
+                     fprintf(stderr, "tee: invalid pipe size: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 break;
+             case 't':
+                 threaded_mode = 1;
+                 break;
+             case 'L':
+                 for (lag_policy = LAG_BLOCK; lag_policy <= LAG_DETACH; lag_policy++) {
+                     if (strcmp(optarg, lag_policy_names[lag_policy]) == 0) {
+                         break;
+                     }
+                 }
+                 if (lag_policy > LAG_DETACH) {
+                     fprintf(stderr, "tee: invalid lag policy: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 threaded_mode = 1;
+                 break;
+             case 'R':
+                 ring_size = (unsigned int)strtoul(optarg, NULL, 10);
+                 if (ring_size == 0 || ring_size > 65536) {
+                     fprintf(stderr, "tee: invalid ring size: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 threaded_mode = 1;
+                 break;
+             case 'U':
+                 uring_mode = 1;
+                 break;
+             case 'S':
+                 sync_bytes = parse_size(optarg);
+                 if (sync_bytes == 0) {
+                     fprintf(stderr, "tee: invalid sync size: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 break;
+             case 'I':
+                 sync_interval_ms = strtol(optarg, NULL, 10);
+                 if (sync_interval_ms <= 0) {
+                     fprintf(stderr, "tee: invalid sync interval: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 break;
+             case 'D':
+                 direct_mode = 1;
+                 break;
+             case 'z':
+                 compress_all = 1;
+                 break;
+             case 'B':
+                 rotate_bytes = parse_size(optarg);
+                 if (rotate_bytes == 0) {
+                     fprintf(stderr, "tee: invalid rotation size: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 break;
+             case 'T':
+                 rotate_seconds = strtod(optarg, NULL);
+                 if (rotate_seconds <= 0) {
+                     fprintf(stderr, "tee: invalid rotation interval: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 break;
+             case 'N':
+                 rotate_name = optarg;
+                 break;
+             case 'W':
+                 rotate_lines = 1;
+                 break;
+             case 'O':
+                 line_timeout_ms = strtol(optarg, &end, 10);
+                 if (*end != '\0' || end == optarg || line_timeout_ms < 0) {
+                     fprintf(stderr, "tee: invalid line timeout: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 break;
+             case 'X':
+                 stats_mode = 1;
+                 stats_path = optarg;
+                 break;
+             case 'C':
+                 compress_level = (int)strtol(optarg, NULL, 10);
+                 if (compress_level < 1 || compress_level > 9) {
+                     fprintf(stderr, "tee: invalid compression level: %s\n", optarg);
+                     exit(EXIT_FAILURE);
+                 }
+                 break;
              case 'h':
                  print_help();
                  exit(EXIT_SUCCESS);
@@ -112,85 +2255,159 @@
          }
      }
  
-     /* Set up signal handling */
+     /* Set up signal handling; no SA_RESTART, so a blocked read returns */
+     memset(&stop_action, 0, sizeof(stop_action));
+     stop_action.sa_handler = signal_handler;
+     sigemptyset(&stop_action.sa_mask);
+     sigaction(SIGTERM, &stop_action, NULL);
      if (ignore_interrupts) {
          signal(SIGINT, SIG_IGN);
      } else {
-         signal(SIGINT, signal_handler);
+         sigaction(SIGINT, &stop_action, NULL);
      }
  
-     /* Prepare file descriptors */
-     num_files = argc - optind;
-     if (num_files > 0) {
-         file_descriptors = malloc(num_files * sizeof(int));
-         if (!file_descriptors) {
-             perror("Memory allocation error");
-             exit(EXIT_FAILURE);
+     /* Prepare sinks: standard output first, then the files */
+     num_sinks = 1 + argc - optind;
+     sinks = calloc(num_sinks, sizeof(struct sink));
+     if (!sinks) {
+         perror("Memory allocation error");
+         exit(EXIT_FAILURE);
+     }
+     for (int i = 0; i < num_sinks; i++) {
+         sinks[i].name = i > 0 ? argv[optind + i - 1] : "standard output";
+         sinks[i].fd = i > 0 ? -1 : STDOUT_FILENO;
+         sinks[i].relay[0] = sinks[i].relay[1] = -1;
+     }
+ 
+     /* Before any other thread exists, so they all inherit SIGUSR1 blocked */
+     if (stats_mode && stats_setup(stats_path) < 0) {
+         fprintf(stderr, "tee: %s: %s\n", stats_path ? stats_path : "--stats", strerror(errno));
+         exit(EXIT_FAILURE);
+     }
+ 
+     /* Open files */
+     for (int i = 1; i < num_sinks; i++) {
+         int flags = O_WRONLY | O_CREAT;
+         
+         flags |= append_flag ? O_APPEND : O_TRUNC;
+         
+         sinks[i].fd = open(sinks[i].name, flags, 0666);
+         if (sinks[i].fd == -1) {
+             fprintf(stderr, "tee: %s: %s\n", sinks[i].name, strerror(errno));
+             atomic_store(&output_failed, 1);
+             continue;
          }
+         sinks[i].last_sync = now_seconds();
  
-         /* Open files */
-         for (int i = 0; i < num_files; i++) {
-             int flags = O_WRONLY | O_CREAT;
-             
-             flags |= append_flag ? O_APPEND : O_TRUNC;
-             
-             file_descriptors[i] = open(argv[optind + i], flags, 0666);
-             if (file_descriptors[i] == -1) {
-                 fprintf(stderr, "tee: %s: %s\n", argv[optind + i], strerror(errno));
-                 file_descriptors[i] = -1;  // Mark as invalid
+         /* O_DIRECT only for regular files written from offset 0 */
+         if (direct_mode) {
+             struct stat st;
+             void *bounce = NULL;
+             if (!append_flag && fstat(sinks[i].fd, &st) == 0 && S_ISREG(st.st_mode) &&
+                 posix_memalign(&bounce, DIRECT_ALIGN, DIRECT_BUFFER_SIZE) == 0 &&
+                 fcntl(sinks[i].fd, F_SETFL, fcntl(sinks[i].fd, F_GETFL) | O_DIRECT) == 0) {
+                 sinks[i].bounce = bounce;
+                 sinks[i].direct = 1;
+             } else {
+                 free(bounce);
+                 if (verbose_mode) {
+                     fprintf(stderr, "%s: O_DIRECT not possible, using buffered writes\n",
+                             sinks[i].name);
+                 }
+             }
+         }
+         
+         /* gzip output; appending adds a member, which gunzip concatenates */
+         size_t name_len = strlen(sinks[i].name);
+         if (compress_all || (name_len > 3 && strcmp(sinks[i].name + name_len - 3, ".gz") == 0)) {
+             if (gzip_init(&sinks[i].gz, compress_level) < 0) {
+                 fprintf(stderr, "tee: %s: cannot start compression\n", sinks[i].name);
+                 close(sinks[i].fd);
+                 sinks[i].fd = -1;
+                 atomic_store(&output_failed, 1);
                  continue;
              }
-             
-             if (verbose_mode) {
-                 fprintf(stderr, "Opened file: %s (fd: %d, mode: %s)\n", 
-                         argv[optind + i], 
-                         file_descriptors[i], 
-                         append_flag ? "append" : "overwrite");
+             sinks[i].compress = 1;
+             if (!threaded_mode) {
+                 threaded_mode = 1;
+                 if (verbose_mode) {
+                     fprintf(stderr, "%s: compressed, using writer threads\n", sinks[i].name);
+                 }
              }
          }
+         
+         if (rotation_mode() && rotation_setup(&sinks[i]) < 0) {
+             fprintf(stderr, "tee: %s: cannot set up rotation\n", sinks[i].name);
+             exit(EXIT_FAILURE);
+         }
+         
+         if (verbose_mode) {
+             fprintf(stderr, "Opened file: %s (fd: %d, mode: %s)\n", 
+                     sinks[i].name, 
+                     sinks[i].fd, 
+                     append_flag ? "append" : "overwrite");
+         }
      }
  
-     /* Set output buffering */
-     if (output_linebuffered) {
-         setvbuf(stdout, NULL, _IOLBF, 0);
+     /* Main copy: writer threads if asked for, else zero-copy when stdin
+      * is a pipe, read/write otherwise */
+     pipe_size = stdin_pipe_size();
+     chunk_size = buffer_size ? buffer_size : pipe_size > 0 ? pipe_size : MIN_BUFFER_SIZE;
+     if (copy_options_active() && verbose_mode && uring_mode && !threaded_mode) {
+         fprintf(stderr, "--io-uring ignored with sync, O_DIRECT, rotation or line options\n");
      }
- 
-     /* Main read/write loop */
-     while ((bytes_read = read(STDIN_FILENO, buffer, BUFFER_SIZE)) > 0) {
-         /* Write to standard output */
-         if (write(STDOUT_FILENO, buffer, bytes_read) != bytes_read) {
-             perror("Error writing to standard output");
-             break;
+     if (threaded_mode) {
+         engine_name = "threaded";
+         status = threaded_loop(chunk_size);
+     } else if (uring_mode && !copy_options_active() &&
+                (engine_name = "io_uring", (status = uring_loop(chunk_size)) != 0)) {
+         /* Done; 0 means io_uring was unavailable and nothing was read */
+     } else if (pipe_size > 0 && !copy_options_active() && setup_splice(pipe_size) == 0) {
+         engine_name = "splice";
+         if (verbose_mode) {
+             fprintf(stderr, "Using tee(2)/splice(2) path (pipe size %zu)\n", pipe_size);
          }
- 
-         /* Write to all files */
-         for (int i = 0; i < num_files; i++) {
-             if (file_descriptors[i] != -1) {
-                 if (write(file_descriptors[i], buffer, bytes_read) != bytes_read) {
-                     fprintf(stderr, "tee: %s: %s\n", argv[optind + i], strerror(errno));
-                     close(file_descriptors[i]);
-                     file_descriptors[i] = -1;  // Mark as invalid
-                 }
-             }
+         status = splice_loop(pipe_size);
+     } else {
+         if (verbose_mode) {
+             fprintf(stderr, "Using read/write path (%s)\n",
+                     pipe_size == 0 ? "standard input is not a pipe" :
+                     copy_options_active() ? "options given" : "relay pipes unavailable");
          }
+         engine_name = "read/write";
+         status = copy_loop(pipe_size > 0 ? pipe_size : MIN_BUFFER_SIZE);
      }
  
-     /* Check for read error */
-     if (bytes_read == -1) {
-         perror("Read error");
+     if (stop_signal && verbose_mode) {
+         fprintf(stderr, "Received signal %d\n", (int)stop_signal);
      }
  
+     rotation_shutdown();
+ 
      /* Close files */
-     for (int i = 0; i < num_files; i++) {
-         if (file_descriptors[i] != -1) {
-             if (close(file_descriptors[i]) == -1) {
+     for (int i = 1; i < num_sinks; i++) {
+         if (sinks[i].relay[0] != -1) {
+             close(sinks[i].relay[0]);
+             close(sinks[i].relay[1]);
+         }
+         if (sink_finish(&sinks[i]) < 0) {
+             status = -1;
+         }
+         if (sinks[i].fd != -1) {
+             if (close(sinks[i].fd) == -1) {
                  fprintf(stderr, "Error closing file: %s\n", strerror(errno));
+                 status = -1;
              }
          }
      }
  
+     if (stats_mode) {
+         stats_dump("exit");
+     }
+ 
      /* Free memory */
-     free(file_descriptors);
+     free(sinks);
  
-     return EXIT_SUCCESS;
+     /* Any failed read or write, including a file dropped on the way */
+     return status < 0 || atomic_load(&output_failed) ? EXIT_FAILURE : EXIT_SUCCESS;
  }
\ No newline at end of file
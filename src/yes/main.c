@@ -18,6 +18,7 @@
  * limitations under the License.
  */
 
+ #define _GNU_SOURCE
  #include <stdio.h>
  #include <stdlib.h>
  #include <string.h>
@@ -25,9 +26,42 @@
  #include <stdbool.h>
  #include <getopt.h>
  #include <signal.h>
+ #include <errno.h>
+ #include <time.h>
+ #include <fcntl.h>
+ #include <pthread.h>
+ 
+ #include "../common/repeat_output.h"
  
  #define VERSION "1.0.0"
- #define BUFFER_SIZE 8192
+ #define PACER_WAKEUPS 1000  // upper bound on --rate wakeups per second
+ 
+ // What every stream repeats and when it stops; fixed once options are parsed
+ struct settings {
+     char* const* words;
+     int nwords;
+     bool add_newline;
+     long long limit;       // lines per stream, negative means infinite
+     long long byte_limit;  // bytes per stream, negative means infinite
+     double rate;
+     bool rate_in_bytes;
+ };
+ 
+ // One destination. Each stream owns its block, pacer and counters, so
+ // fan-out workers share nothing but the read-only settings.
+ struct stream {
+     const char* name;
+     char label[32];
+     int fd;
+     bool close_fd;
+     struct output out;
+     unsigned long long bytes;
+     double seconds;
+     int error;
+     pthread_t thread;
+ };
+ 
+ static struct settings settings;
  
  // Flag to control program execution
  volatile sig_atomic_t keep_running = 1;
@@ -37,6 +71,199 @@
      keep_running = 0;
  }
  
+ // Join the words with spaces (plus the newline) straight into the start of
+ // an output block, then replicate that line through the rest of it
+ static char* build_block(char* const* words, int nwords, bool add_newline,
+                          size_t* line_len, size_t* copies) {
+     size_t len = add_newline ? 1 : 0;
+     char* block;
+     char* p;
+ 
+     for (int i = 0; i < nwords; i++) {
+         len += strlen(words[i]) + (i > 0 ? 1 : 0);
+     }
+     *line_len = len;
+     if (len == 0) {
+         *copies = 0;
+         return NULL;
+     }
+ 
+     block = alloc_block(len, copies);
+     if (!block) {
+         return NULL;
+     }
+ 
+     p = block;
+     for (int i = 0; i < nwords; i++) {
+         if (i > 0) {
+             *p++ = ' ';
+         }
+         p = stpcpy(p, words[i]);
+     }
+     if (add_newline) {
+         *p = '\n';
+     }
+ 
+     replicate_block(block, len, *copies);
+     return block;
+ }
+ 
+ // Token bucket for --rate, refilled from CLOCK_MONOTONIC. The deadline of
+ // every batch is computed from a fixed origin, so time spent writing or
+ // oversleeping never accumulates into drift.
+ struct pacer {
+     double rate;               // lines per second, 0 means unpaced
+     size_t batch;              // lines released per wakeup
+     struct timespec origin;    // when the bucket was last anchored
+     unsigned long long sent;   // lines released since origin
+ };
+ 
+ static void pacer_init(struct pacer* pacer, double rate, size_t max_batch) {
+     pacer->rate = rate;
+     pacer->batch = max_batch;
+     pacer->sent = 0;
+     if (rate > 0) {
+         // Enough lines per batch to stay under PACER_WAKEUPS sleeps a second
+         double batch = rate / PACER_WAKEUPS;
+         pacer->batch = batch < 1 ? 1 : (size_t)batch;
+         if (pacer->batch > max_batch) {
+             pacer->batch = max_batch;
+         }
+     }
+     clock_gettime(CLOCK_MONOTONIC, &pacer->origin);
+ }
+ 
+ // Sleep until the bucket holds enough tokens for the next batch of lines
+ static void pacer_wait(struct pacer* pacer, size_t lines) {
+     struct timespec now, deadline;
+     double offset, lag;
+ 
+     if (pacer->rate <= 0) {
+         return;
+     }
+ 
+     offset = pacer->sent / pacer->rate;
+     deadline.tv_sec = pacer->origin.tv_sec + (time_t)offset;
+     deadline.tv_nsec = pacer->origin.tv_nsec + (long)((offset - (time_t)offset) * 1e9);
+     if (deadline.tv_nsec >= 1000000000L) {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000L;
+     }
+ 
+     clock_gettime(CLOCK_MONOTONIC, &now);
+     lag = (double)(now.tv_sec - deadline.tv_sec) + (double)(now.tv_nsec - deadline.tv_nsec) / 1e9;
+     if (lag > pacer->batch / pacer->rate) {
+         // A stalled reader must not be repaid with a burst: the bucket
+         // holds at most one batch, so re-anchor at the present
+         pacer->origin = now;
+         pacer->sent = 0;
+     } else if (lag < 0) {
+         while (keep_running &&
+                clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+         }
+     }
+     pacer->sent += lines;
+ }
+ 
+ // Parse N[K|M|G][B]: lines per second, or bytes per second with B
+ static int parse_rate(const char* text, double* rate, bool* in_bytes) {
+     char* end;
+     double value = strtod(text, &end);
+ 
+     switch (*end) {
+         case 'k': case 'K': value *= 1e3; end++; break;
+         case 'm': case 'M': value *= 1e6; end++; break;
+         case 'g': case 'G': value *= 1e9; end++; break;
+     }
+     *in_bytes = (*end == 'b' || *end == 'B');
+     if (*in_bytes) {
+         end++;
+     }
+     if (end == text || *end != '\0' || !(value > 0)) {
+         return -1;
+     }
+     *rate = value;
+     return 0;
+ }
+ 
+ static double elapsed_seconds(const struct timespec* start) {
+     struct timespec now;
+     clock_gettime(CLOCK_MONOTONIC, &now);
+     return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+ }
+ 
+ // Parse a byte count with an optional K, M or G (binary) suffix
+ static long long parse_size(const char* text) {
+     char* end;
+     long long value = strtoll(text, &end, 10);
+ 
+     switch (*end) {
+         case 'k': case 'K': value <<= 10; end++; break;
+         case 'm': case 'M': value <<= 20; end++; break;
+         case 'g': case 'G': value <<= 30; end++; break;
+     }
+     if (end == text || *end != '\0' || value < 0) {
+         return -1;
+     }
+     return value;
+ }
+ 
+ // Repeat the line into one destination until a limit or a signal stops it
+ static void* run_stream(void* arg) {
+     struct stream* st = arg;
+     struct pacer pacer;
+     struct timespec start;
+     size_t line_len, copies;
+     long long count = 0;
+     char* block;
+ 
+     block = build_block(settings.words, settings.nwords, settings.add_newline, &line_len, &copies);
+     if (!block) {
+         // line_len == 0 means there is nothing to repeat (-n with "")
+         st->error = line_len ? ENOMEM : 0;
+         return NULL;
+     }
+ 
+     setup_output(&st->out, st->fd);
+     pacer_init(&pacer, settings.rate_in_bytes ? settings.rate / line_len : settings.rate, copies);
+     clock_gettime(CLOCK_MONOTONIC, &start);
+ 
+     // One write per block (or per paced batch), trimmed on the last one so
+     // that --limit and --bytes stay exact
+     while (keep_running &&
+            (settings.limit < 0 || count < settings.limit) &&
+            (settings.byte_limit < 0 || st->bytes < (unsigned long long)settings.byte_limit)) {
+         size_t lines = pacer.batch;
+         size_t len;
+ 
+         if (settings.limit >= 0 && (unsigned long long)(settings.limit - count) < lines) {
+             lines = (size_t)(settings.limit - count);
+         }
+         len = lines * line_len;
+         if (settings.byte_limit >= 0 && settings.byte_limit - st->bytes < len) {
+             len = (size_t)(settings.byte_limit - st->bytes);
+         }
+ 
+         pacer_wait(&pacer, lines);
+         if (!keep_running) {
+             break;
+         }
+         if (emit(&st->out, block, len) < 0) {
+             if (errno != EPIPE) {
+                 st->error = errno;
+             }
+             break;
+         }
+         st->bytes += len;
+         count += lines;
+     }
+ 
+     st->seconds = elapsed_seconds(&start);
+     close_output(&st->out);
+     free(block);
+     return NULL;
+ }
+ 
  // Print help message
  void print_help(const char* program_name) {
      printf("Usage: %s [OPTION]... [STRING]...\n", program_name);
@@ -45,16 +272,33 @@
      printf("  -v, --version    output version information and exit\n");
      printf("  -n, --newline    don't output the trailing newline\n");
      printf("  -l N, --limit=N  stop after N iterations\n");
+     printf("  -c N, --bytes=N  stop each output after exactly N bytes\n");
+     printf("  -o FILE, --output=FILE\n");
+     printf("                   write to FILE instead of standard output; repeat to\n");
+     printf("                   fan out to several files, one writer thread each\n");
+     printf("  --fds=N          write to inherited descriptors 3 .. N+2 instead of\n");
+     printf("                   standard output, as well as to any -o FILEs\n");
+     printf("  -r, --rate=N[KMG][B]\n");
+     printf("                   emit N lines per second (N bytes with B)\n");
+     printf("  -t, --throughput report bytes written and rate on stderr at exit\n");
+     printf("\nThroughput check:\n");
+     printf("  %s -t > /dev/null      measure raw output rate (interrupt with Ctrl+C)\n", program_name);
+     printf("  %s | pv > /dev/null    measure rate through a pipe\n", program_name);
+     printf("  %s -t -c 1G -o a -o b  write 1 GiB to each of two files in parallel\n", program_name);
      printf("\nPart of QCO MoreUtils by AnmiTaliDev.\n");
      printf("Licensed under Apache License 2.0.\n");
  }
  
  int main(int argc, char *argv[]) {
-     char buffer[BUFFER_SIZE];
-     const char* output = "y";
-     bool add_newline = true;
-     long long limit = -1; // Negative means infinite
+     bool report_throughput = false;
+     const char** output_files = NULL;
+     int num_output_files = 0;
+     int num_fds = 0;
      int c;
+ 
+     settings.add_newline = true;
+     settings.limit = -1; // Negative means infinite
+     settings.byte_limit = -1;
      
      // Define long options
      static struct option long_options[] = {
@@ -62,6 +306,11 @@
          {"version", no_argument, 0, 'v'},
          {"newline", no_argument, 0, 'n'},
          {"limit", required_argument, 0, 'l'},
+         {"bytes", required_argument, 0, 'c'},
+         {"output", required_argument, 0, 'o'},
+         {"fds", required_argument, 0, 'F'},
+         {"rate", required_argument, 0, 'r'},
+         {"throughput", no_argument, 0, 't'},
          {0, 0, 0, 0}
      };
      
@@ -70,7 +319,7 @@
      signal(SIGTERM, handle_signal);
  
      // Process command line options
-     while ((c = getopt_long(argc, argv, "hvnl:", long_options, NULL)) != -1) {
+     while ((c = getopt_long(argc, argv, "hvnl:c:o:r:t", long_options, NULL)) != -1) {
          switch (c) {
              case 'h':
                  print_help(argv[0]);
@@ -81,15 +330,46 @@
                  printf("License Apache 2.0\n");
                  return 0;
              case 'n':
-                 add_newline = false;
+                 settings.add_newline = false;
                  break;
              case 'l':
-                 limit = atoll(optarg);
-                 if (limit < 0) {
+                 settings.limit = atoll(optarg);
+                 if (settings.limit < 0) {
                      fprintf(stderr, "Error: Limit must be a non-negative number\n");
                      return 1;
                  }
                  break;
+             case 'c':
+                 settings.byte_limit = parse_size(optarg);
+                 if (settings.byte_limit < 0) {
+                     fprintf(stderr, "Error: Invalid byte count '%s'\n", optarg);
+                     return 1;
+                 }
+                 break;
+             case 'o':
+                 output_files = realloc(output_files, (num_output_files + 1) * sizeof(*output_files));
+                 if (!output_files) {
+                     perror("yes: memory allocation error");
+                     return 1;
+                 }
+                 output_files[num_output_files++] = optarg;
+                 break;
+             case 'F':
+                 num_fds = atoi(optarg);
+                 if (num_fds <= 0) {
+                     fprintf(stderr, "Error: --fds must be a positive number\n");
+                     return 1;
+                 }
+                 break;
+             case 'r':
+                 if (parse_rate(optarg, &settings.rate, &settings.rate_in_bytes) < 0) {
+                     fprintf(stderr, "Error: Invalid rate '%s'\n", optarg);
+                     return 1;
+                 }
+                 break;
+             case 't':
+                 report_throughput = true;
+                 break;
              case '?':
                  return 1;
              default:
@@ -97,35 +377,92 @@
          }
      }
  
-     // Check if we have arguments to output instead of default "y"
+     // Repeat the remaining arguments, or the default "y"
+     static char* const default_words[] = { "y" };
+     settings.words = default_words;
+     settings.nwords = 1;
      if (optind < argc) {
-         // Combine all remaining arguments with spaces between them
-         buffer[0] = '\0';
-         for (int i = optind; i < argc; i++) {
-             if (i > optind) {
-                 strcat(buffer, " ");
-             }
-             strcat(buffer, argv[i]);
-             
-             // Check if buffer is getting too full
-             if (strlen(buffer) > BUFFER_SIZE - 100) {
+         settings.words = argv + optind;
+         settings.nwords = argc - optind;
+     }
+ 
+     // Collect destinations: the named files and inherited descriptors, or
+     // standard output when neither was given
+     int num_streams = num_output_files + num_fds;
+     struct stream* streams;
+     int status = 0;
+ 
+     if (num_streams == 0) {
+         num_streams = 1;
+     }
+     streams = calloc(num_streams, sizeof(*streams));
+     if (!streams) {
+         perror("yes: memory allocation error");
+         return 1;
+     }
+     if (num_output_files + num_fds == 0) {
+         streams[0].name = "standard output";
+         streams[0].fd = STDOUT_FILENO;
+     }
+     for (int i = 0; i < num_output_files; i++) {
+         streams[i].name = output_files[i];
+         streams[i].fd = open(output_files[i], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+         streams[i].close_fd = true;
+         if (streams[i].fd < 0) {
+             fprintf(stderr, "yes: %s: %s\n", output_files[i], strerror(errno));
+             return 1;
+         }
+     }
+     for (int i = 0; i < num_fds; i++) {
+         struct stream* st = &streams[num_output_files + i];
+         st->fd = 3 + i;
+         snprintf(st->label, sizeof(st->label), "descriptor %d", st->fd);
+         st->name = st->label;
+         if (fcntl(st->fd, F_GETFD) < 0) {
+             fprintf(stderr, "yes: %s: %s\n", st->name, strerror(errno));
+             return 1;
+         }
+     }
+ 
+     if (num_streams == 1) {
+         run_stream(&streams[0]);
+     } else {
+         // A reader going away should end its own stream, not the process
+         signal(SIGPIPE, SIG_IGN);
+         for (int i = 0; i < num_streams; i++) {
+             int err = pthread_create(&streams[i].thread, NULL, run_stream, &streams[i]);
+             if (err != 0) {
+                 fprintf(stderr, "yes: cannot start writer thread: %s\n", strerror(err));
+                 keep_running = 0;
+                 num_streams = i;
+                 status = 1;
                  break;
              }
          }
-         output = buffer;
+         for (int i = 0; i < num_streams; i++) {
+             pthread_join(streams[i].thread, NULL);
+         }
      }
  
-     // Main output loop
-     long long count = 0;
-     while (keep_running && (limit < 0 || count < limit)) {
-         if (add_newline) {
-             printf("%s\n", output);
-         } else {
-             printf("%s", output);
-             fflush(stdout);
+     for (int i = 0; i < num_streams; i++) {
+         struct stream* st = &streams[i];
+         if (st->error) {
+             fprintf(stderr, "yes: %s: %s\n", st->name, strerror(st->error));
+             status = 1;
+         }
+         if (report_throughput) {
+             fprintf(stderr, "yes: %s%s%llu bytes in %.3f s (%.2f MB/s, via %s)\n",
+                     num_streams > 1 ? st->name : "", num_streams > 1 ? ": " : "",
+                     st->bytes, st->seconds, st->seconds > 0 ? st->bytes / st->seconds / 1e6 : 0.0,
+                     output_method_name(st->out.method));
+         }
+         if (st->close_fd && close(st->fd) < 0 && !st->error) {
+             fprintf(stderr, "yes: %s: %s\n", st->name, strerror(errno));
+             status = 1;
          }
-         count++;
      }
  
-     return 0;
+     free(streams);
+     free(output_files);
+     return status;
  }
\ No newline at end of file